@@ -0,0 +1,456 @@
+#include "Intrinsics.hpp"
+#include "Eigen/Dense"
+#include "EigenDataSetLoader.hpp"
+#include "bench_kernels.hpp"
+#include "Conv2D.hpp"
+#include "FullyConnected.hpp"
+#include "Loss.hpp"
+#include "MaxPool2D.hpp"
+#include "Optimizers.hpp"
+#include "Quantization.hpp"
+#include "ReLU.hpp"
+#include "SoftMax.hpp"
+#include "SoftMaxCrossEntropyLoss.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using Tensor = Eigen::MatrixXd;
+
+/**
+ * @brief Writes a synthetic MNIST-style IDX image and label file pair with about 19% non-zero pixels.
+ *
+ * @param {images_path} Output path of the image file.
+ * @param {labels_path} Output path of the label file.
+ * @param {num_images} Number of 28x28 images.
+ *
+ * @return None
+ */
+void write_synthetic_dataset(const std::string& images_path, const std::string& labels_path, int num_images)
+{
+    auto write_int = [](std::ofstream& out, uint32_t value) {
+        value = __builtin_bswap32(value);
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> pixel(1, 255);
+    std::uniform_int_distribution<int> label(0, 9);
+    std::bernoulli_distribution non_zero(0.19);
+
+    std::ofstream images(images_path, std::ios::binary);
+    write_int(images, 2051);
+    write_int(images, num_images);
+    write_int(images, 28);
+    write_int(images, 28);
+    std::vector<unsigned char> raw(28 * 28);
+    for (int i = 0; i < num_images; i++)
+    {
+        std::generate(raw.begin(), raw.end(), [&]() { return non_zero(gen) ? pixel(gen) : 0; });
+        images.write(reinterpret_cast<const char*>(raw.data()), raw.size());
+    }
+
+    std::ofstream labels(labels_path, std::ios::binary);
+    write_int(labels, 2049);
+    write_int(labels, num_images);
+    for (int i = 0; i < num_images; i++)
+    {
+        const auto value = static_cast<unsigned char>(label(gen));
+        labels.write(reinterpret_cast<const char*>(&value), 1);
+    }
+}
+
+/**
+ * @brief Benchmarks every kernel over the batch x hidden size grid.
+ *
+ * @return All benchmark results.
+ */
+std::vector<BenchResult> run_benchmarks()
+{
+    const std::vector<long> batch_sizes = {1, 32, 100, 256};
+    const std::vector<long> hidden_sizes = {128, 500, 1024};
+    const long input_size = 784;
+    const long output_size = 10;
+    const double word = sizeof(double);
+
+    std::vector<BenchResult> results = run_matvec_benchmarks(hidden_sizes);
+    std::srand(42);
+
+    for (long hidden : hidden_sizes)
+    {
+        // ADAM over a tensor the size of the first layer's parameters
+        ADAM adam(1e-3, 0.9, 0.999, 1e-8);
+        Tensor weights = Tensor::Random(hidden, input_size + 1);
+        Tensor gradient = Tensor::Random(hidden, input_size + 1) * 1e-3;
+        const double params = static_cast<double>(hidden) * (input_size + 1);
+        results.push_back(measure("adam_update", 0, hidden, 12.0 * params, word * 5.0 * params,
+                                  [&]() { adam.step(weights, gradient); }));
+
+        // SGD with momentum reads weights, gradient and velocity and writes weights and velocity
+        SGD momentum(1e-3, 0.9);
+        results.push_back(measure("sgd_momentum_update", 0, hidden, 4.0 * params, word * 5.0 * params,
+                                  [&]() { momentum.step(weights, gradient); }));
+    }
+
+    for (long batch : batch_sizes)
+    {
+        for (long hidden : hidden_sizes)
+        {
+            // SGD keeps the optimizer share of the backward pass small
+            SGD sgd(1e-6);
+            Xavier weights_initializer(1);
+            Xavier bias_initializer(2);
+            FullyConnected fc(input_size, hidden, &sgd);
+            fc.initialize(&weights_initializer, &bias_initializer);
+
+            const Tensor input = Tensor::Random(batch, input_size);
+            const Tensor error = Tensor::Random(batch, hidden);
+            const double weights = static_cast<double>(hidden) * (input_size + 1);
+            Tensor out;
+
+            results.push_back(measure("fc_forward", batch, hidden, 2.0 * batch * weights,
+                                      word * (batch * input_size + weights + batch * hidden),
+                                      [&]() { out = fc.forward(input); }));
+            fc.forward(input);
+            results.push_back(measure("fc_backward", batch, hidden, 4.0 * batch * weights + 2.0 * weights,
+                                      word * (batch * hidden + batch * (input_size + 1) + 3.0 * weights +
+                                              batch * input_size),
+                                      [&]() { out = fc.backward(error); }));
+
+            // The same layer in single precision
+            BasicSGD<float> sgd_f32(1e-6);
+            BasicXavier<float> weights_initializer_f32(1);
+            BasicXavier<float> bias_initializer_f32(2);
+            BasicFullyConnected<Eigen::Dynamic, Eigen::Dynamic, false, float> fc_f32(input_size, hidden, &sgd_f32);
+            fc_f32.initialize(&weights_initializer_f32, &bias_initializer_f32);
+            const BasicTensor<float> input_f32 = input.cast<float>();
+            const BasicTensor<float> error_f32 = error.cast<float>();
+            const double word_f32 = sizeof(float);
+            BasicTensor<float> out_f32;
+            results.push_back(measure("fc_forward_f32", batch, hidden, 2.0 * batch * weights,
+                                      word_f32 * (batch * input_size + weights + batch * hidden),
+                                      [&]() { out_f32 = fc_f32.forward(input_f32); }));
+            fc_f32.forward(input_f32);
+            results.push_back(measure("fc_backward_f32", batch, hidden, 4.0 * batch * weights + 2.0 * weights,
+                                      word_f32 * (batch * hidden + batch * (input_size + 1) + 3.0 * weights +
+                                                  batch * input_size),
+                                      [&]() { out_f32 = fc_f32.backward(error_f32); }));
+
+            // The single precision layer with bfloat16 products; it still reads and writes float tensors
+            fc_f32.set_mixed_precision(true);
+            results.push_back(measure("fc_forward_bf16", batch, hidden, 2.0 * batch * weights,
+                                      word_f32 * (batch * input_size + weights + batch * hidden),
+                                      [&]() { out_f32 = fc_f32.forward(input_f32); }));
+            fc_f32.forward(input_f32);
+            results.push_back(measure("fc_backward_bf16", batch, hidden, 4.0 * batch * weights + 2.0 * weights,
+                                      word_f32 * (batch * hidden + batch * (input_size + 1) + 3.0 * weights +
+                                                  batch * input_size),
+                                      [&]() { out_f32 = fc_f32.backward(error_f32); }));
+
+            // The single precision layer quantized to int8, on uint8 inputs
+            const int8::QuantizedFullyConnected fc_int8(fc_f32.weights, fc_f32.bias,
+                                                        Eigen::VectorXd::Constant(input_size, 1.0 / 255.0));
+            const int8::ByteTensor input_u8 = ((input.array() + 1.0) * 127.5).cast<std::uint8_t>();
+            int8::FloatTensor out_int8;
+            results.push_back(measure("fc_forward_int8", batch, hidden, 2.0 * batch * weights,
+                                      batch * input_size + weights + word_f32 * batch * hidden,
+                                      [&]() { fc_int8.forward(input_u8, out_int8); }));
+
+            // Fully connected layer with the fused ReLU, to compare against fc_* plus relu_*
+            FullyConnectedReLU fc_relu(input_size, hidden, &sgd);
+            fc_relu.initialize(&weights_initializer, &bias_initializer);
+            results.push_back(measure("fc_relu_forward", batch, hidden, 2.0 * batch * weights + batch * hidden,
+                                      word * (batch * input_size + weights + batch * hidden),
+                                      [&]() { out = fc_relu.forward(input); }));
+            fc_relu.forward(input);
+            results.push_back(measure("fc_relu_backward", batch, hidden,
+                                      4.0 * batch * weights + 2.0 * weights + batch * hidden,
+                                      word * (2.0 * batch * hidden + batch * (input_size + 1) + 3.0 * weights +
+                                              batch * input_size),
+                                      [&]() { out = fc_relu.backward(error); }));
+
+            ReLU relu;
+            const Tensor activations = Tensor::Random(batch, hidden);
+            const double elements = static_cast<double>(batch) * hidden;
+            results.push_back(measure("relu_forward", batch, hidden, elements, word * 3.0 * elements,
+                                      [&]() { out = relu.forward(activations); }));
+            results.push_back(measure("relu_backward", batch, hidden, elements, word * 3.0 * elements,
+                                      [&]() { out = relu.backward(error); }));
+        }
+
+        SoftMax softmax;
+        CrossEntropyLoss loss;
+        const Tensor logits = Tensor::Random(batch, output_size);
+        const Tensor error = Tensor::Random(batch, output_size);
+        Tensor labels = Tensor::Zero(batch, output_size);
+        for (long i = 0; i < batch; i++)
+        {
+            labels(i, i % output_size) = 1.0;
+        }
+        const Tensor predictions = softmax.forward(logits);
+        const double elements = static_cast<double>(batch) * output_size;
+        Tensor out;
+        double loss_value = 0.0;
+
+        results.push_back(measure("softmax_forward", batch, 0, 4.0 * elements, word * 2.0 * elements,
+                                  [&]() { out = softmax.forward(logits); }));
+        results.push_back(measure("softmax_backward", batch, 0, 4.0 * elements, word * 3.0 * elements,
+                                  [&]() { out = softmax.backward(error); }));
+        results.push_back(measure("cross_entropy_loss", batch, 0, 3.0 * elements, word * 2.0 * elements,
+                                  [&]() { loss_value += loss.computed_loss(predictions, labels); }));
+        results.push_back(measure("cross_entropy_backward", batch, 0, 2.0 * elements, word * 3.0 * elements,
+                                  [&]() { out = loss.backward(labels); }));
+
+        // Fused head: softmax and loss from the logits in one call, then p - y
+        SoftMaxCrossEntropyLoss softmax_loss;
+        Tensor probabilities(batch, output_size);
+        results.push_back(measure("softmax_cross_entropy_loss", batch, 0, 6.0 * elements, word * 3.0 * elements,
+                                  [&]() { loss_value += softmax_loss.computed_loss(logits, labels, probabilities); }));
+        results.push_back(measure("softmax_cross_entropy_backward", batch, 0, elements, word * 3.0 * elements,
+                                  [&]() { out = softmax_loss.backward(labels); }));
+        if (loss_value == 0.0)
+        {
+            std::fprintf(stderr, "Warning: cross entropy loss evaluated to zero\n");
+        }
+    }
+
+    // 5x5 convolution of 28x28 images with the fused ReLU, and 2x2 max pooling of its maps; the hidden column is the
+    // number of filters
+    const long side = 28;
+    const long kernel = 5;
+    const long maps_side = side - kernel + 1;
+    for (long batch : batch_sizes)
+    {
+        for (long filters : {8L, 16L, 32L})
+        {
+            SGD sgd(1e-6);
+            Xavier weights_initializer(1);
+            Xavier bias_initializer(2);
+            Conv2DReLU conv(1, side, side, filters, kernel, &sgd);
+            conv.initialize(&weights_initializer, &bias_initializer);
+
+            const Tensor input = Tensor::Random(batch, side * side);
+            const double positions = static_cast<double>(maps_side) * maps_side;
+            const double maps = filters * positions;
+            const double weights = filters * (kernel * kernel + 1.0);
+            const Tensor error = Tensor::Random(batch, static_cast<long>(maps));
+            Tensor out;
+            // The patches are written once and read once per pass
+            const double patches = batch * positions * kernel * kernel;
+            results.push_back(measure("conv_relu_forward", batch, filters, 2.0 * batch * positions * weights,
+                                      word * (batch * side * side + 2.0 * patches + weights + batch * maps),
+                                      [&]() { out = conv.forward(input); }));
+            conv.forward(input);
+            results.push_back(measure("conv_relu_backward", batch, filters, 4.0 * batch * positions * weights,
+                                      word * (2.0 * batch * maps + 3.0 * patches + 3.0 * weights +
+                                              batch * side * side),
+                                      [&]() { out = conv.backward(error); }));
+
+            MaxPool2D pool(filters, maps_side, maps_side, 2);
+            const Tensor feature_maps = Tensor::Random(batch, static_cast<long>(maps));
+            const Tensor pooled_error = Tensor::Random(batch, static_cast<long>(maps / 4));
+            // One comparison per input element; the indices of the maxima are ints
+            results.push_back(measure("maxpool_forward", batch, filters, batch * maps,
+                                      word * batch * maps * 1.25 + sizeof(int) * batch * maps / 4,
+                                      [&]() { out = pool.forward(feature_maps); }));
+            pool.forward(feature_maps);
+            results.push_back(measure("maxpool_backward", batch, filters, batch * maps / 4,
+                                      word * batch * maps * 1.25 + sizeof(int) * batch * maps / 4,
+                                      [&]() { out = pool.backward(pooled_error); }));
+        }
+    }
+
+    // Loaders read a synthetic 1000 image dataset; the byte count is the file payload
+    const int num_images = 1000;
+    const auto dir = std::filesystem::temp_directory_path();
+    const std::string images_path = (dir / "bench_kernels-images.idx3-ubyte").string();
+    const std::string labels_path = (dir / "bench_kernels-labels.idx1-ubyte").string();
+    write_synthetic_dataset(images_path, labels_path, num_images);
+
+    const double pixels = num_images * 28.0 * 28.0;
+    RowMajorTensor images;
+    SparseTensor sparse_images;
+    Tensor labels;
+    results.push_back(measure("load_images", num_images, 0, pixels, pixels + word * pixels, [&]() {
+        EigenDataSetLoader loader(images_path);
+        images = loader.read_images();
+    }));
+    results.push_back(measure("load_images_sparse", num_images, 0, pixels, pixels, [&]() {
+        EigenDataSetLoader loader(images_path);
+        sparse_images = loader.read_images_sparse();
+    }));
+    results.push_back(measure("load_labels", num_images, 0, 0.0, num_images * (1.0 + 10.0 * word), [&]() {
+        EigenDataSetLoader loader(labels_path);
+        labels = loader.read_labels();
+    }));
+
+    std::filesystem::remove(images_path);
+    std::filesystem::remove(labels_path);
+
+    return results;
+}
+
+/**
+ * @brief Writes the results as JSON, one result object per line.
+ *
+ * @param {out} Output stream.
+ * @param {results} The benchmark results.
+ *
+ * @return None
+ */
+void write_json(std::FILE* out, const std::vector<BenchResult>& results)
+{
+    std::fprintf(out, "{\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        std::fprintf(out,
+                     "    {\"name\": \"%s\", \"batch\": %ld, \"hidden\": %ld, \"ns_per_op\": %.1f, \"gflops\": %.3f, "
+                     "\"gbps\": %.3f}%s\n",
+                     r.name.c_str(), r.batch, r.hidden, r.ns_per_op, r.gflops, r.gbps,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
+
+/**
+ * @brief Reads results written by write_json(). Only that line-per-result layout is understood.
+ *
+ * @param {filename} Path of the JSON file.
+ *
+ * @return Results keyed by BenchResult::key(), empty if the file cannot be read.
+ */
+std::map<std::string, BenchResult> read_json(const std::string& filename)
+{
+    std::map<std::string, BenchResult> results;
+    std::ifstream in(filename);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        char name[128] = {};
+        BenchResult r{};
+        if (std::sscanf(line.c_str(),
+                        " {\"name\": \"%127[^\"]\", \"batch\": %ld, \"hidden\": %ld, \"ns_per_op\": %lf, \"gflops\": "
+                        "%lf, \"gbps\": %lf}",
+                        name, &r.batch, &r.hidden, &r.ns_per_op, &r.gflops, &r.gbps) == 6)
+        {
+            r.name = name;
+            results[r.key()] = r;
+        }
+    }
+    return results;
+}
+
+/**
+ * @brief Compares results against a baseline and reports every kernel that got slower by more than tolerance.
+ *
+ * @param {results} The current results.
+ * @param {baseline} The baseline results.
+ * @param {tolerance} Allowed relative slowdown, e.g. 0.25 for 25%.
+ *
+ * @return Number of regressions.
+ */
+int compare_with_baseline(const std::vector<BenchResult>& results, const std::map<std::string, BenchResult>& baseline,
+                          double tolerance)
+{
+    int regressions = 0;
+    std::fprintf(stderr, "\n%-40s %14s %14s %9s\n", "kernel/batch/hidden", "baseline [ns]", "current [ns]", "change");
+    for (const BenchResult& r : results)
+    {
+        auto it = baseline.find(r.key());
+        if (it == baseline.end())
+        {
+            std::fprintf(stderr, "%-40s %14s %14.1f %9s\n", r.key().c_str(), "-", r.ns_per_op, "new");
+            continue;
+        }
+        const double change = r.ns_per_op / it->second.ns_per_op - 1.0;
+        const bool regressed = change > tolerance;
+        regressions += regressed;
+        std::fprintf(stderr, "%-40s %14.1f %14.1f %+8.1f%%%s\n", r.key().c_str(), it->second.ns_per_op, r.ns_per_op,
+                     100.0 * change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+/**
+ * @brief Entry point for the program {bench_kernels.cpp}
+ *
+ * Usage: bench_kernels [--output <file.json>] [--baseline <file.json>] [--tolerance <fraction>]
+ * The JSON goes to stdout unless --output is given; a human readable table goes to stderr.
+ *
+ * @param {argc} cmd-line argument count.
+ * @param {argv} cmd-line argument values.
+ *
+ * @return 0 on success, 1 on invalid arguments, 2 if a kernel regressed against the baseline.
+ */
+int main(int argc, char* argv[])
+{
+    std::string output_file;
+    std::string baseline_file;
+    double tolerance = 0.25;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            output_file = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            baseline_file = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+        {
+            tolerance = std::stod(argv[++i]);
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--output <file.json>] [--baseline <file.json>] [--tolerance <fraction>]\n",
+                         argv[0]);
+            return 1;
+        }
+    }
+
+    const std::vector<BenchResult> results = run_benchmarks();
+
+    std::FILE* out = output_file.empty() ? stdout : std::fopen(output_file.c_str(), "w");
+    if (!out)
+    {
+        std::fprintf(stderr, "Error: Unable to open output file: %s\n", output_file.c_str());
+        return 1;
+    }
+    write_json(out, results);
+    if (out != stdout)
+    {
+        std::fclose(out);
+    }
+
+    if (baseline_file.empty())
+    {
+        return 0;
+    }
+
+    const auto baseline = read_json(baseline_file);
+    if (baseline.empty())
+    {
+        std::fprintf(stderr, "Error: No results found in baseline file: %s\n", baseline_file.c_str());
+        return 1;
+    }
+
+    const int regressions = compare_with_baseline(results, baseline, tolerance);
+    if (regressions > 0)
+    {
+        std::fprintf(stderr, "\n%d kernel(s) regressed by more than %.0f%% against %s\n", regressions,
+                     100.0 * tolerance, baseline_file.c_str());
+        return 2;
+    }
+    std::fprintf(stderr, "\nNo regressions against %s\n", baseline_file.c_str());
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include "bench_kernels.hpp"
+#include "matvec.hpp"
+
+/**
+ * @brief Benchmarks matvec() and matvecTransposed() on a hidden x 784 matrix, i.e. the first layer of a
+ * single-sample forward and backward pass.
+ *
+ * @param {hidden_sizes} Matrix row counts.
+ *
+ * @return The benchmark results.
+ */
+std::vector<BenchResult> run_matvec_benchmarks(const std::vector<long>& hidden_sizes)
+{
+    const long input_size = 784;
+    const double word = sizeof(double);
+
+    std::vector<BenchResult> results;
+    for (long hidden : hidden_sizes)
+    {
+        Matrix<double> mat(hidden, input_size);
+        Vector<double> vec(input_size);
+        Vector<double> error(hidden);
+        std::fill(mat.data(), mat.data() + hidden * input_size, 0.5);
+        std::fill(vec.data(), vec.data() + input_size, 0.25);
+        std::fill(error.data(), error.data() + hidden, 0.125);
+
+        const double flops = 2.0 * hidden * input_size;
+        const double bytes = word * (hidden * input_size + input_size + hidden);
+        Vector<double> out;
+        results.push_back(measure("matvec", 0, hidden, flops, bytes, [&]() { out = matvec(mat, vec); }));
+        results.push_back(
+            measure("matvec_transposed", 0, hidden, flops, bytes, [&]() { out = matvecTransposed(mat, error); }));
+    }
+    return results;
+}
@@ -0,0 +1,297 @@
+#include "Intrinsics.hpp"
+#include "Eigen/Dense"
+#include "matvec.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Largest accepted deviation between a kernel and its reference. Inputs are uniform in [-1, 1], so the rounding
+// error of the longest benchmarked reduction (100000 terms) stays orders of magnitude below this.
+constexpr double kTolerance = 1e-9;
+
+/**
+ * @brief Prints one result row's error column and reports whether it is within kTolerance.
+ *
+ * @param {max_err} The largest absolute deviation from the reference.
+ *
+ * @return True if max_err is within kTolerance.
+ */
+bool check_error(double max_err)
+{
+    const bool ok = max_err <= kTolerance;
+    std::printf(" %12.2e%s\n", max_err, ok ? "" : "  FAILED");
+    return ok;
+}
+
+/**
+ * @brief Times a callable and returns the best-of-five average wall time per call in nanoseconds.
+ *
+ * @param {fn} The callable to benchmark.
+ * @param {reps} Calls per measurement.
+ *
+ * @return Nanoseconds per call.
+ */
+template <typename Fn>
+double time_ns(Fn&& fn, int reps)
+{
+    fn(); // warm-up
+
+    double best = 1e300;
+    for (int trial = 0; trial < 5; trial++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; r++)
+        {
+            fn();
+        }
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / reps);
+    }
+    return best;
+}
+
+/**
+ * @brief Benchmarks matvecNaive(), matvec() and Eigen's GEMV on the same row-major data for one matrix shape.
+ *
+ * @param {rows} Number of matrix rows.
+ * @param {cols} Number of matrix columns.
+ *
+ * @return True if matvec() matches both references within kTolerance.
+ */
+bool bench_shape(size_t rows, size_t cols)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    Matrix<double> mat(rows, cols);
+    Vector<double> vec(cols);
+    std::generate(mat.data(), mat.data() + rows * cols, [&]() { return dist(gen); });
+    std::generate(vec.data(), vec.data() + cols, [&]() { return dist(gen); });
+
+    using RowMajorMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    Eigen::Map<const RowMajorMatrix> eigen_mat(mat.data(), rows, cols);
+    Eigen::Map<const Eigen::VectorXd> eigen_vec(vec.data(), cols);
+    Eigen::VectorXd eigen_out(rows);
+
+    // Aim for roughly 50M multiply-adds per measurement, but never below one call
+    const int reps = static_cast<int>(std::max<size_t>(1, 50'000'000 / (rows * cols)));
+    const double flops = 2.0 * rows * cols;
+
+    Vector<double> naive_out;
+    Vector<double> fast_out;
+    double naive_ns = time_ns([&]() { naive_out = matvecNaive(mat, vec); }, std::max(1, reps / 20));
+    double fast_ns = time_ns([&]() { fast_out = matvec(mat, vec); }, reps);
+    double eigen_ns = time_ns([&]() { eigen_out.noalias() = eigen_mat * eigen_vec; }, reps);
+
+    double max_err = 0.0;
+    for (size_t row = 0; row < rows; row++)
+    {
+        max_err = std::max(max_err, std::abs(fast_out(row) - naive_out(row)));
+        max_err = std::max(max_err, std::abs(fast_out(row) - eigen_out(row)));
+    }
+
+    std::printf("%6zu x %-6zu %14.1f %14.1f %14.1f %10.2f %10.2f %10.2f", rows, cols, naive_ns, fast_ns, eigen_ns,
+                flops / naive_ns, flops / fast_ns, flops / eigen_ns);
+    return check_error(max_err);
+}
+
+/**
+ * @brief Benchmarks matvecFixed() against matvec() for one compile-time matrix shape.
+ *
+ * @return True if matvecFixed() matches matvec() within kTolerance.
+ */
+template< size_t Rows, size_t Cols >
+bool bench_fixed_shape()
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    Matrix<double> mat(Rows, Cols);
+    Vector<double> vec(Cols);
+    std::generate(mat.data(), mat.data() + Rows * Cols, [&]() { return dist(gen); });
+    std::generate(vec.data(), vec.data() + Cols, [&]() { return dist(gen); });
+
+    const int reps = static_cast<int>(std::max<size_t>(1, 50'000'000 / (Rows * Cols)));
+    const double flops = 2.0 * Rows * Cols;
+
+    Vector<double> dynamic_out;
+    Vector<double> fixed_out;
+    double dynamic_ns = time_ns([&]() { dynamic_out = matvec(mat, vec); }, reps);
+    double fixed_ns = time_ns([&]() { fixed_out = matvecFixed< Rows, Cols >(mat, vec); }, reps);
+
+    double max_err = 0.0;
+    for (size_t row = 0; row < Rows; row++)
+    {
+        max_err = std::max(max_err, std::abs(fixed_out(row) - dynamic_out(row)));
+    }
+
+    std::printf("%6zu x %-6zu %14.1f %14.1f %10.2f %10.2f", Rows, Cols, dynamic_ns, fixed_ns, flops / dynamic_ns,
+                flops / fixed_ns);
+    return check_error(max_err);
+}
+
+/**
+ * @brief Benchmarks matvecTransposed() and ger() against Eigen on the same row-major data for one matrix shape.
+ *
+ * @param {rows} Number of matrix rows.
+ * @param {cols} Number of matrix columns.
+ *
+ * @return True if both kernels match Eigen within kTolerance.
+ */
+bool bench_transposed_shape(size_t rows, size_t cols)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    Matrix<double> mat(rows, cols);
+    Vector<double> x(rows);
+    Vector<double> y(cols);
+    std::generate(mat.data(), mat.data() + rows * cols, [&]() { return dist(gen); });
+    std::generate(x.data(), x.data() + rows, [&]() { return dist(gen); });
+    std::generate(y.data(), y.data() + cols, [&]() { return dist(gen); });
+
+    using RowMajorMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    Eigen::Map<const RowMajorMatrix> eigen_mat(mat.data(), rows, cols);
+    Eigen::Map<const Eigen::VectorXd> eigen_x(x.data(), rows);
+    Eigen::Map<const Eigen::VectorXd> eigen_y(y.data(), cols);
+    Eigen::VectorXd eigen_out(cols);
+
+    const int reps = static_cast<int>(std::max<size_t>(1, 50'000'000 / (rows * cols)));
+    const double flops = 2.0 * rows * cols;
+    const double alpha = 0.5;
+
+    Vector<double> out;
+    double transposed_ns = time_ns([&]() { out = matvecTransposed(mat, x); }, reps);
+    double eigen_transposed_ns = time_ns([&]() { eigen_out.noalias() = eigen_mat.transpose() * eigen_x; }, reps);
+
+    double max_err = 0.0;
+    for (size_t col = 0; col < cols; col++)
+    {
+        max_err = std::max(max_err, std::abs(out(col) - eigen_out(col)));
+    }
+
+    // ger() updates in place, so time it on a scratch matrix and check a single update of the original separately.
+    Matrix<double> scratch = mat;
+    RowMajorMatrix eigen_scratch = eigen_mat;
+    double ger_ns = time_ns([&]() { ger(alpha, x, y, scratch); }, reps);
+    double eigen_ger_ns = time_ns([&]() { eigen_scratch.noalias() += alpha * eigen_x * eigen_y.transpose(); }, reps);
+
+    RowMajorMatrix eigen_updated = eigen_mat;
+    eigen_updated.noalias() += alpha * eigen_x * eigen_y.transpose();
+    Matrix<double> updated = mat;
+    ger(alpha, x, y, updated);
+    for (size_t row = 0; row < rows; row++)
+    {
+        for (size_t col = 0; col < cols; col++)
+        {
+            max_err = std::max(max_err, std::abs(updated(row, col) - eigen_updated(row, col)));
+        }
+    }
+
+    std::printf("%6zu x %-6zu %14.1f %14.1f %14.1f %14.1f %10.2f %10.2f", rows, cols, transposed_ns,
+                eigen_transposed_ns, ger_ns, eigen_ger_ns, flops / transposed_ns, flops / ger_ns);
+    return check_error(max_err);
+}
+
+/**
+ * @brief Benchmarks matmul() against Eigen's GEMM on the same row-major data for one product shape.
+ *
+ * @param {m} Rows of the left-hand side.
+ * @param {k} Columns of the left-hand side / rows of the right-hand side.
+ * @param {n} Columns of the right-hand side.
+ *
+ * @return True if matmul() matches Eigen within kTolerance.
+ */
+bool bench_matmul_shape(size_t m, size_t k, size_t n)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+    Matrix<double> lhs(m, k);
+    Matrix<double> rhs(k, n);
+    std::generate(lhs.data(), lhs.data() + m * k, [&]() { return dist(gen); });
+    std::generate(rhs.data(), rhs.data() + k * n, [&]() { return dist(gen); });
+
+    using RowMajorMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    Eigen::Map<const RowMajorMatrix> eigen_lhs(lhs.data(), m, k);
+    Eigen::Map<const RowMajorMatrix> eigen_rhs(rhs.data(), k, n);
+    RowMajorMatrix eigen_out(m, n);
+
+    const int reps = static_cast<int>(std::max<size_t>(1, 500'000'000 / (m * k * n)));
+    const double flops = 2.0 * m * k * n;
+
+    Matrix<double> out;
+    double fast_ns = time_ns([&]() { out = matmul(lhs, rhs); }, reps);
+    double eigen_ns = time_ns([&]() { eigen_out.noalias() = eigen_lhs * eigen_rhs; }, reps);
+
+    double max_err = 0.0;
+    for (size_t row = 0; row < m; row++)
+    {
+        for (size_t col = 0; col < n; col++)
+        {
+            max_err = std::max(max_err, std::abs(out(row, col) - eigen_out(row, col)));
+        }
+    }
+
+    std::printf("%5zu x %-5zu x %-5zu %14.1f %14.1f %10.2f %10.2f", m, k, n, fast_ns, eigen_ns, flops / fast_ns,
+                flops / eigen_ns);
+    return check_error(max_err);
+}
+
+/**
+ * @brief Entry point for the program {bench_matvec.cpp}
+ *
+ * @return EXIT_FAILURE if any kernel deviates from its reference by more than kTolerance.
+ */
+int main()
+{
+    bool ok = true;
+
+    std::printf("%-15s %14s %14s %14s %10s %10s %10s %12s\n", "shape", "naive [ns]", "matvec [ns]", "eigen [ns]",
+                "naive GF/s", "matvec GF/s", "eigen GF/s", "max |err|");
+
+    const std::vector<std::pair<size_t, size_t>> shapes = {
+        {10, 500}, {500, 784}, {784, 784}, {1000, 1000}, {2048, 2048}, {4096, 4096}, {1, 100000}};
+
+    for (auto [rows, cols] : shapes)
+    {
+        ok &= bench_shape(rows, cols);
+    }
+
+    std::printf("\n%-15s %14s %14s %10s %10s %12s\n", "fixed shape", "matvec [ns]", "fixed [ns]", "matvec GF/s",
+                "fixed GF/s", "max |err|");
+
+    ok &= bench_fixed_shape< 10, 500 >();
+    ok &= bench_fixed_shape< 10, 128 >();
+    ok &= bench_fixed_shape< 128, 784 >();
+    ok &= bench_fixed_shape< 500, 784 >();
+
+    std::printf("\n%-15s %14s %14s %14s %14s %10s %10s %12s\n", "shape", "mat^T x [ns]", "eigen [ns]", "ger [ns]",
+                "eigen [ns]", "mat^T GF/s", "ger GF/s", "max |err|");
+
+    const std::vector<std::pair<size_t, size_t>> transposed_shapes = {{10, 500}, {500, 784}, {1000, 1000}, {2048, 2048}};
+
+    for (auto [rows, cols] : transposed_shapes)
+    {
+        ok &= bench_transposed_shape(rows, cols);
+    }
+
+    std::printf("\n%-19s %14s %14s %10s %10s %12s\n", "shape", "matmul [ns]", "eigen [ns]", "matmul GF/s",
+                "eigen GF/s", "max |err|");
+
+    const std::vector<std::array<size_t, 3>> gemm_shapes = {
+        {100, 784, 500}, {100, 500, 10}, {500, 100, 784}, {256, 256, 256}, {1024, 1024, 1024}};
+
+    for (auto [m, k, n] : gemm_shapes)
+    {
+        ok &= bench_matmul_shape(m, k, n);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
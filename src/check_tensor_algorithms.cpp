@@ -0,0 +1,149 @@
+#include "tensor.hpp"
+#include "tensor_algorithms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief Prints one check's result row.
+ *
+ * @param {name} The checked algorithm.
+ * @param {n} The number of elements.
+ * @param {ok} Whether the algorithm matched its serial reference.
+ *
+ * @return ok
+ */
+bool report(const char* name, size_t n, bool ok)
+{
+    std::printf("%-12s %10zu %10s\n", name, n, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/**
+ * @brief Checks every algorithm of tensor_algorithms.hpp on n elements against a serial loop.
+ * The values are small integers, so sums are exact in any order and the results must match bit for bit.
+ *
+ * @param {n} The number of elements.
+ *
+ * @return True if all algorithms match their reference.
+ */
+bool check_size(size_t n)
+{
+    std::mt19937 gen(static_cast< unsigned >(n));
+    std::uniform_int_distribution< int > dist(-1000, 1000);
+
+    Tensor< double > a({n});
+    Tensor< double > b({n});
+    std::generate(a.data(), a.data() + n, [&]() { return dist(gen); });
+    std::generate(b.data(), b.data() + n, [&]() { return dist(gen); });
+    const double* in_a = std::as_const(a).data();
+    const double* in_b = std::as_const(b).data();
+
+    bool ok = true;
+
+    Tensor< double > out({n});
+    transform(a, out, [](double x) { return 3.0 * x - 1.0; });
+    ok &= report("transform", n, [&]() {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (out({i}) != 3.0 * in_a[i] - 1.0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }());
+
+    // Binary transform, writing through a view of the output.
+    transform(a, b.view(), out.view(), std::multiplies<>());
+    ok &= report("transform2", n, [&]() {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (out({i}) != in_a[i] * in_b[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }());
+
+    fill(out, 7.0);
+    ok &= report("fill", n, std::all_of(out.data(), out.data() + n, [](double x) { return x == 7.0; }));
+
+    double serial_sum = 0.0;
+    double serial_max = in_a[0];
+    for (size_t i = 0; i < n; i++)
+    {
+        serial_sum += in_a[i];
+        serial_max = std::max(serial_max, in_a[i]);
+    }
+    ok &= report("reduce", n,
+                 reduce(a, 0.0, std::plus<>()) == serial_sum &&
+                     reduce(a, -1e300, [](double x, double y) { return std::max(x, y); }) == serial_max);
+    ok &= report("sum", n, sum(a) == serial_sum);
+
+    // Two equal maxima, the second one in the last chunk: the first must win.
+    Tensor< double > peaks = a;
+    const size_t first = n / 3;
+    peaks({first}) = 5000.0;
+    peaks({n - 1}) = 5000.0;
+    ok &= report("argmax", n, argmax(a) == static_cast< size_t >(std::max_element(in_a, in_a + n) - in_a) &&
+                                  argmax(peaks) == first);
+
+    Tensor< double > normalized = a;
+    normalize(normalized);
+    const double lo = *std::min_element(in_a, in_a + n);
+    const double hi = *std::max_element(in_a, in_a + n);
+    const double scale = hi > lo ? 1.0 / (hi - lo) : 0.0;
+    ok &= report("normalize", n, [&]() {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (normalized({i}) != (in_a[i] - lo) * scale)
+            {
+                return false;
+            }
+        }
+        return true;
+    }());
+
+    // A single element off by more than the tolerance, in the last chunk.
+    Tensor< double > close = a;
+    close({n - 1}) += 1e-3;
+    ok &= report("allClose", n, allClose(a, close, 1e-2) && !allClose(a, close, 1e-4) &&
+                                    !allClose(a, Tensor< double >({n + 1}), 1.0));
+
+    return ok;
+}
+
+/**
+ * @brief Entry point for the program {check_tensor_algorithms.cpp}
+ * Runs the checks on both sides of PARALLEL_THRESHOLD with several threads, so the parallel branches and the
+ * combination of their per-thread results are covered on a single-core machine as well.
+ *
+ * @return EXIT_FAILURE if any algorithm deviates from its serial reference.
+ */
+int main()
+{
+#ifdef _OPENMP
+    omp_set_num_threads(std::max(4, omp_get_max_threads()));
+#endif
+
+    std::printf("%-12s %10s %10s\n", "algorithm", "elements", "result");
+
+    bool ok = true;
+    for (size_t n : {size_t{1}, size_t{17}, PARALLEL_THRESHOLD - 1, PARALLEL_THRESHOLD, 3 * PARALLEL_THRESHOLD + 7})
+    {
+        ok &= check_size(n);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,15 +1,77 @@
 #pragma once
 
+#include "Intrinsics.hpp"
 #include "Eigen/Dense"
+#include "Eigen/SparseCore"
+
+// Tensors of a given scalar type (double or float); the unqualified names below are the double versions
+template <typename Scalar>
+using BasicTensor = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+// Batch x features in CSR format, i.e. one list of non-zero feature indices per sample
+template <typename Scalar>
+using BasicSparseTensor = Eigen::SparseMatrix<Scalar, Eigen::RowMajor>;
+// Views for the buffer based layer API: plain tensors and row blocks of a workspace bind without a copy
+template <typename Scalar>
+using BasicTensorRef = Eigen::Ref<BasicTensor<Scalar>>;
+template <typename Scalar>
+using BasicConstTensorRef = Eigen::Ref<const BasicTensor<Scalar>>;
+// Batch x features with every sample in a contiguous row, like the images of the dataset; a row block of it is a
+// contiguous batch, which the input layer reads in place
+template <typename Scalar>
+using BasicRowMajorTensor = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+template <typename Scalar>
+using BasicConstRowMajorTensorRef = Eigen::Ref<const BasicRowMajorTensor<Scalar>>;
 
 using Tensor = Eigen::MatrixXd;
+using SparseTensor = BasicSparseTensor<double>;
+using TensorRef = BasicTensorRef<double>;
+using ConstTensorRef = BasicConstTensorRef<double>;
+using RowMajorTensor = BasicRowMajorTensor<double>;
+using ConstRowMajorTensorRef = BasicConstRowMajorTensorRef<double>;
+
+/**
+ * @brief Scoped permission for Eigen heap allocations. Only has an effect in builds with EIGEN_RUNTIME_NO_MALLOC
+ * (make NO_MALLOC_CHECK=1), where a forbidden allocation fails an assertion.
+ */
+class MallocGuard
+{
+public:
+    explicit MallocGuard(bool allowed)
+    {
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+        previous = Eigen::internal::is_malloc_allowed();
+        Eigen::internal::set_is_malloc_allowed(allowed);
+#else
+        (void)allowed;
+#endif
+    }
+    ~MallocGuard()
+    {
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+        Eigen::internal::set_is_malloc_allowed(previous);
+#endif
+    }
+    MallocGuard(const MallocGuard &) = delete;
+    MallocGuard &operator=(const MallocGuard &) = delete;
+
+private:
+    bool previous = true;
+};
 
-class BaseLayer
+/**
+ * @brief Common interface of all layers, for tensors of the given scalar type
+ */
+template <typename Scalar = double>
+class BasicBaseLayer
 {
 public:
-    BaseLayer() : trainable(false), weights(Tensor()) {}
+    using Tensor = BasicTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+
+    BasicBaseLayer() : trainable(false) {}
     // BaseLayer(bool is_trainable) : trainable(is_trainable), weights(Tensor()) {}
-    virtual ~BaseLayer() = default;
+    virtual ~BasicBaseLayer() = default;
 
     /**
      * @author Lam Tran
@@ -33,6 +95,55 @@ public:
      */
     virtual Tensor backward(const Tensor &error_tensor) = 0;
 
+    /**
+     * @brief Forward pass into a caller-provided buffer. Layers that override it do not allocate once reserve() has
+     * sized their workspaces, and may keep a view of input (and output) for the backward pass, so both must stay
+     * alive and unchanged until backward() has run. The default falls back to the allocating forward().
+     *
+     * @param input Input tensor from the predecessor layer
+     * @param output Batch x output features, written by the layer
+     */
+    virtual void forward(const ConstTensorRef &input, TensorRef output)
+    {
+        output = forward(Tensor(input));
+    }
+
+    /**
+     * @brief Backward pass into a caller-provided buffer, after a buffer based forward pass
+     *
+     * @param error Error tensor from the successor layer
+     * @param error_prev Batch x input features, the error tensor for the predecessor layer
+     */
+    virtual void backward(const ConstTensorRef &error, TensorRef error_prev)
+    {
+        error_prev = backward(Tensor(error));
+    }
+
+    /**
+     * @brief Sizes the internal workspaces for batches of up to max_batch_size samples
+     *
+     * @param max_batch_size
+     */
+    virtual void reserve(Eigen::Index max_batch_size)
+    {
+        (void)max_batch_size;
+    }
+
+    /**
+     * @brief Features per sample of the output for inputs with input_width features. The default is a layer that
+     * keeps the shape, e.g. an activation.
+     *
+     * @param input_width
+     * @return Eigen::Index
+     */
+    virtual Eigen::Index output_width(Eigen::Index input_width) const
+    {
+        return input_width;
+    }
+
     bool trainable;
-    Tensor weights;
-};
\ No newline at end of file
+    // View of the weights of a trainable layer, which live in a parameter arena of the layer or of its network
+    Eigen::Map<Tensor> weights{nullptr, 0, 0};
+};
+
+using BaseLayer = BasicBaseLayer<>;
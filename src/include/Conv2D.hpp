@@ -0,0 +1,413 @@
+#pragma once
+
+#include "BaseLayer.hpp"
+#include "Eigen/Dense"
+#include "Gemm.hpp"
+#include "Initializers.hpp"
+#include "Optimizers.hpp"
+#include "ParameterArena.hpp"
+#include <algorithm>
+#include <concepts>
+#include <optional>
+#include <utility>
+
+using Tensor = Eigen::MatrixXd;
+
+/**
+ * @brief 2D convolution (cross-correlation with stride 1 and zero padding) of channels x height x width images into
+ * @brief filters x out_height x out_width feature maps. Both are stored one sample per row in channel-major order,
+ * @brief like the flattened dataset images, so the layer composes with the fully connected one.
+ * @brief The batch is convolved with one GEMM via im2col. The patches matrix has a row per (output position, sample),
+ * @brief position-major, and a column per (channel, kernel row, kernel column), which makes
+ * @brief - every patch column a copy of blocks of the batch x feature input, one per output row and kernel offset
+ * @brief - the product patches x W^T, (positions * batch) x filters, the batch x (filters * positions) output tensor
+ * @brief   itself in memory, so the GEMM writes to the output directly if its batch rows are contiguous.
+ * @brief ReLUEpilogue fuses the activation into the pass that adds the bias, and the backward pass masks the error with
+ * @brief the sign of the layer's own output, as in the fully connected layer.
+ */
+template <bool ReLUEpilogue = false, typename Scalar = double>
+class BasicConv2D final : public BasicBaseLayer<Scalar>
+{
+public:
+    using Tensor = BasicTensor<Scalar>;
+    using SparseTensor = BasicSparseTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+    using ConstRowMajorTensorRef = BasicConstRowMajorTensorRef<Scalar>;
+    using Optimizer = BasicOptimizer<Scalar>;
+    using Initializer = BasicInitializer<Scalar>;
+
+private:
+    Eigen::Index channels;
+    Eigen::Index height;
+    Eigen::Index width;
+    Eigen::Index filters;
+    Eigen::Index kernel_size;
+    Eigen::Index padding;
+    Eigen::Index out_height;
+    Eigen::Index out_width;
+    // Steps the parameters of the layer in update_parameters(); null once they are bound to the arena of a network
+    Optimizer *optimizer;
+    // Weights, bias, their gradients and the optimizer state, until bind_parameters() moves them into another arena
+    BasicParameterArena<Scalar> own_parameters;
+    // Slot of the weights in the arena, followed by the bias
+    std::size_t parameter_slot = 0;
+    // Patches of the last forward pass, (positions * max batch) x (channels * kernel_size^2); the backward pass
+    // overwrites them with their error once the weight gradient is computed
+    Tensor patches;
+    // Product of the forward pass if the output rows are not contiguous, and the (masked) error of the backward pass
+    // in the same layout
+    Tensor product_workspace;
+    // Packing buffers of the forward, weight gradient and patch error products
+    BasicGemmWorkspace<Scalar> forward_gemm;
+    BasicGemmWorkspace<Scalar> gradient_gemm;
+    BasicGemmWorkspace<Scalar> error_gemm;
+    // Owned output of the allocating forward(); the buffer based one only keeps a view in output_ref, whose positive
+    // entries are the ReLU mask
+    Tensor output_tensor_cache;
+    std::optional<ConstTensorRef> output_ref;
+    Eigen::Map<Tensor> gradient_weights{nullptr, 0, 0};
+    Eigen::Map<Tensor> gradient_bias{nullptr, 0, 0};
+
+    Eigen::Index positions() const
+    {
+        return out_height * out_width;
+    }
+
+    Eigen::Index patch_size() const
+    {
+        return channels * kernel_size * kernel_size;
+    }
+
+public:
+    /**
+     * @brief Construct a convolution of channels x height x width images with filters kernels of
+     * @brief kernel_size x kernel_size
+     * @param channels
+     * @param height
+     * @param width
+     * @param filters Channels of the output
+     * @param kernel_size
+     * @param optimizer
+     * @param padding Zeros around every side of the image, e.g. kernel_size / 2 to keep its size
+     */
+    BasicConv2D(Eigen::Index channels, Eigen::Index height, Eigen::Index width, Eigen::Index filters,
+                Eigen::Index kernel_size, Optimizer *optimizer, Eigen::Index padding = 0)
+        : channels(channels), height(height), width(width), filters(filters), kernel_size(kernel_size),
+          padding(padding), out_height(height + 2 * padding - kernel_size + 1),
+          out_width(width + 2 * padding - kernel_size + 1), optimizer(optimizer)
+    {
+        eigen_assert(out_height > 0 && out_width > 0 && "the kernel does not fit into the padded image");
+        this->trainable = true;
+        add_parameters(own_parameters);
+        own_parameters.allocate(optimizer != nullptr ? optimizer->state_planes() : 0);
+        map_parameters(own_parameters);
+    }
+
+    // Movable into a pipeline (BasicSequential); not copyable, as a copy would step the optimizer state of this layer
+    BasicConv2D(BasicConv2D &&) = default;
+    ~BasicConv2D() {}
+
+    /**
+     * @brief Initialize the weights and bias using the provided initializer, with the patch as fan-in
+     * @param weights_initializer
+     * @param bias_initializer
+     */
+    void initialize(Initializer *weights_initializer, Initializer *bias_initializer)
+    {
+        weights_initializer->initialize(patch_size(), filters);
+        bias_initializer->initialize(1, filters);
+
+        this->weights = weights_initializer->getWeights().transpose();
+        this->bias = bias_initializer->getWeights().transpose();
+    }
+
+    /**
+     * @brief Add the weights and the bias to the arena of a network, before it is allocated
+     * @param arena
+     */
+    void add_parameters(BasicParameterArena<Scalar> &arena)
+    {
+        // Weights are stored filters x (channel, kernel row, kernel column), one flattened kernel per row
+        parameter_slot = arena.add(filters, patch_size());
+        arena.add(filters, 1);
+    }
+
+    /**
+     * @brief Move the weights and the bias into the allocated arena they were added to, whose owner steps them from
+     * @brief then on
+     * @param arena
+     */
+    void bind_parameters(BasicParameterArena<Scalar> &arena)
+    {
+        arena.values(parameter_slot) = this->weights;
+        arena.values(parameter_slot + 1) = this->bias;
+        map_parameters(arena);
+        own_parameters = BasicParameterArena<Scalar>();
+        optimizer = nullptr;
+    }
+
+    /**
+     * @brief Forward pass through the convolution
+     * @param input_tensor
+     * @return Tensor
+     */
+    Tensor forward(const Tensor &input_tensor) override
+    {
+        output_tensor_cache.resize(input_tensor.rows(), filters * positions());
+        forward(input_tensor, output_tensor_cache);
+        return output_tensor_cache;
+    }
+
+    /**
+     * @brief Forward pass for a sparse input batch, which the convolution reads densified
+     * @param input_tensor
+     * @return Tensor
+     */
+    Tensor forward(const SparseTensor &input_tensor)
+    {
+        return forward(Tensor(input_tensor));
+    }
+
+    /**
+     * @brief Backward pass through the convolution
+     * @param error_tensor
+     * @return Tensor
+     */
+    Tensor backward(const Tensor &error_tensor) override
+    {
+        Tensor error_prev(error_tensor.rows(), channels * height * width);
+        backward(error_tensor, error_prev);
+        return error_prev;
+    }
+
+    /**
+     * @brief Convolution into a caller-provided buffer. Keeps the patches, so the input may change afterwards.
+     * @param input Batch x (channels * height * width)
+     * @param output Batch x (filters * out_height * out_width)
+     */
+    void forward(const ConstTensorRef &input, TensorRef output) override
+    {
+        forward_dense(input, output);
+    }
+
+    /**
+     * @brief Convolution of a row-major input batch, e.g. a row block of the dataset, read in place
+     * @param input
+     * @param output
+     */
+    template <std::same_as<ConstRowMajorTensorRef> RowMajorRef>
+    void forward(const RowMajorRef &input, TensorRef output)
+    {
+        forward_dense(input, output);
+    }
+
+    /**
+     * @brief Weight and bias gradients of the last forward pass, and the error of its input scattered back from the
+     * @brief error of the patches (col2im). The error is propagated with the weights of the forward pass, before the
+     * @brief update.
+     * @param error Batch x (filters * out_height * out_width)
+     * @param error_prev Batch x (channels * height * width); empty to skip it, e.g. in the first layer
+     */
+    void backward(const ConstTensorRef &error, TensorRef error_prev) override
+    {
+        const Eigen::Index batch_size = error.rows();
+        const Eigen::Index rows = batch_size * positions();
+        // The error in the layout of the product: the caller's tensor itself if nothing is masked and its rows are
+        // contiguous, else a copy made in the masking pass
+        const Scalar *product_error_data = error.data();
+        if (ReLUEpilogue || error.outerStride() != batch_size)
+        {
+            Eigen::Map<Tensor> masked_error(product_workspace.data(), batch_size, filters * positions());
+            if constexpr (ReLUEpilogue)
+            {
+                masked_error = (output_ref->array() > 0).select(error, Scalar(0));
+            }
+            else
+            {
+                masked_error = error;
+            }
+            product_error_data = product_workspace.data();
+        }
+        const Eigen::Map<const Tensor> product_error(product_error_data, rows, filters);
+        auto patch_rows = patches.topRows(rows);
+
+        gemm(gradient_weights, product_error.transpose(), patch_rows, gradient_gemm);
+        gradient_bias = product_error.colwise().sum().transpose();
+
+        if (error_prev.size() != 0)
+        {
+            gemm(patch_rows, product_error, this->weights, error_gemm);
+            col2im(batch_size, error_prev);
+        }
+
+        update_parameters();
+    }
+
+    void reserve(Eigen::Index max_batch_size) override
+    {
+        if (max_batch_size * positions() > patches.rows())
+        {
+            patches.resize(max_batch_size * positions(), patch_size());
+            product_workspace.resize(max_batch_size * positions(), filters);
+        }
+        forward_gemm.reserve(max_batch_size * positions(), filters, patch_size());
+        gradient_gemm.reserve(filters, patch_size(), max_batch_size * positions());
+        error_gemm.reserve(max_batch_size * positions(), patch_size(), filters);
+    }
+
+    Eigen::Index output_width(Eigen::Index input_width) const override
+    {
+        eigen_assert(input_width == channels * height * width);
+        (void)input_width;
+        return filters * positions();
+    }
+
+    Eigen::Map<Tensor> bias{nullptr, 0, 0};
+
+private:
+    /**
+     * @brief im2col, the GEMM and the fused bias (+ ReLU) epilogue, for an input in either layout
+     * @param input
+     * @param output
+     */
+    template <typename Input>
+    void forward_dense(const Input &input, TensorRef output)
+    {
+        const Eigen::Index batch_size = input.rows();
+        const Eigen::Index rows = batch_size * positions();
+        if (rows > patches.rows())
+        {
+            reserve(batch_size);
+        }
+
+        im2col(input);
+        const bool contiguous = output.outerStride() == batch_size;
+        Eigen::Map<Tensor> product(contiguous ? output.data() : product_workspace.data(), rows, filters);
+        gemm(product, patches.topRows(rows), this->weights.transpose(), forward_gemm);
+        if constexpr (ReLUEpilogue)
+        {
+            product = (product.rowwise() + this->bias.col(0).transpose()).cwiseMax(Scalar(0));
+        }
+        else
+        {
+            product.rowwise() += this->bias.col(0).transpose();
+        }
+        if (!contiguous)
+        {
+            output = Eigen::Map<const Tensor>(product_workspace.data(), batch_size, filters * positions());
+        }
+
+        if constexpr (ReLUEpilogue)
+        {
+            output_ref.emplace(output);
+        }
+    }
+
+    /**
+     * @brief Output columns [begin, end) of an output row whose input pixels for kernel column kernel_col lie inside
+     * @brief the image
+     */
+    std::pair<Eigen::Index, Eigen::Index> valid_columns(Eigen::Index kernel_col) const
+    {
+        return {std::max<Eigen::Index>(0, padding - kernel_col),
+                std::min<Eigen::Index>(out_width, width + padding - kernel_col)};
+    }
+
+    /**
+     * @brief Fill the patches of the batch. Patch column j, viewed as batch x positions, takes for every output row
+     * @brief and kernel offset a batch x (run of output columns) block of the input, zero where it reads padding.
+     * @param input
+     */
+    template <typename Input>
+    void im2col(const Input &input)
+    {
+        const Eigen::Index batch_size = input.rows();
+        for (Eigen::Index channel = 0, j = 0; channel < channels; ++channel)
+        {
+            for (Eigen::Index kernel_row = 0; kernel_row < kernel_size; ++kernel_row)
+            {
+                for (Eigen::Index kernel_col = 0; kernel_col < kernel_size; ++kernel_col, ++j)
+                {
+                    Eigen::Map<Tensor> column(patches.col(j).data(), batch_size, positions());
+                    const auto [begin, end] = valid_columns(kernel_col);
+                    for (Eigen::Index out_row = 0; out_row < out_height; ++out_row)
+                    {
+                        auto patch_row = column.middleCols(out_row * out_width, out_width);
+                        const Eigen::Index in_row = out_row + kernel_row - padding;
+                        if (in_row < 0 || in_row >= height || begin >= end)
+                        {
+                            patch_row.setZero();
+                            continue;
+                        }
+                        patch_row.leftCols(begin).setZero();
+                        patch_row.rightCols(out_width - end).setZero();
+                        patch_row.middleCols(begin, end - begin) = input.middleCols(
+                            (channel * height + in_row) * width + begin + kernel_col - padding, end - begin);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Scatter-add the error of the patches (in place of the patches) back to the input pixels they were
+     * @brief copied from, the transpose of im2col
+     * @param batch_size
+     * @param error_prev
+     */
+    void col2im(Eigen::Index batch_size, TensorRef error_prev)
+    {
+        error_prev.setZero();
+        for (Eigen::Index channel = 0, j = 0; channel < channels; ++channel)
+        {
+            for (Eigen::Index kernel_row = 0; kernel_row < kernel_size; ++kernel_row)
+            {
+                for (Eigen::Index kernel_col = 0; kernel_col < kernel_size; ++kernel_col, ++j)
+                {
+                    const Eigen::Map<const Tensor> column(patches.col(j).data(), batch_size, positions());
+                    const auto [begin, end] = valid_columns(kernel_col);
+                    for (Eigen::Index out_row = 0; out_row < out_height; ++out_row)
+                    {
+                        const Eigen::Index in_row = out_row + kernel_row - padding;
+                        if (in_row < 0 || in_row >= height || begin >= end)
+                        {
+                            continue;
+                        }
+                        error_prev.middleCols((channel * height + in_row) * width + begin + kernel_col - padding,
+                                              end - begin) +=
+                            column.middleCols(out_row * out_width + begin, end - begin);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Step the optimizer on the weights and the bias, in place, with the gradients of the last backward pass,
+     * @brief unless the network whose arena they are bound to steps them
+     */
+    void update_parameters()
+    {
+        if (optimizer != nullptr)
+        {
+            const typename Optimizer::Parameter parameter = own_parameters.parameter();
+            optimizer->step(typename Optimizer::ParamGroup(&parameter, 1));
+        }
+    }
+
+    /**
+     * @brief Point the weights, the bias and their gradients to their slots in the arena
+     * @param arena
+     */
+    void map_parameters(BasicParameterArena<Scalar> &arena)
+    {
+        new (&this->weights) Eigen::Map<Tensor>(arena.values(parameter_slot));
+        new (&this->bias) Eigen::Map<Tensor>(arena.values(parameter_slot + 1));
+        new (&gradient_weights) Eigen::Map<Tensor>(arena.gradient(parameter_slot));
+        new (&gradient_bias) Eigen::Map<Tensor>(arena.gradient(parameter_slot + 1));
+    }
+};
+
+using Conv2D = BasicConv2D<>;
+using Conv2DReLU = BasicConv2D<true>;
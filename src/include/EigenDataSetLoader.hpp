@@ -1,18 +1,26 @@
 #pragma once
 
+#include "BaseLayer.hpp"
 #include "Eigen/Dense"
+#include "Eigen/SparseCore"
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 using Tensor = Eigen::MatrixXd;
+// Raw pixels, one image per contiguous row
+using PixelTensor = BasicRowMajorTensor<std::uint8_t>;
 
 /**
  * @author Hamiz Ali
  * @since 24.01.2025
  *
  * @brief A class to load MNIST dataset in Eigen::MatrixXd format.
+ * @brief The read functions take the scalar type of the tensors as template parameter (double by default).
+ * @brief Dense images are row-major, one image per contiguous row, so that a batch is a contiguous row block.
  */
 
 class EigenDataSetLoader
@@ -23,15 +31,22 @@ private:
   int32_t read_big_endian_int();
   std::vector<unsigned char> read_bytes(std::size_t size);
   void validate_file_open() const;
-  Tensor normalize_image_data(const std::vector<unsigned char> &data, int rows, int cols) const;
-  Tensor one_hot_encode_labels(const std::vector<unsigned char> &data, int numLabels) const;
+  template <typename Scalar>
+  BasicTensor<Scalar> normalize_image_data(const std::vector<unsigned char> &data, int rows, int cols) const;
+  template <typename Scalar>
+  BasicTensor<Scalar> one_hot_encode_labels(const std::vector<unsigned char> &data, int numLabels) const;
 
 public:
   explicit EigenDataSetLoader(const std::string &filename);
   ~EigenDataSetLoader();
 
-  Tensor read_images();
-  Tensor read_labels();
+  template <typename Scalar = double>
+  BasicRowMajorTensor<Scalar> read_images();
+  template <typename Scalar = double>
+  BasicSparseTensor<Scalar> read_images_sparse();
+  PixelTensor read_images_raw();
+  template <typename Scalar = double>
+  BasicTensor<Scalar> read_labels();
 };
 
 /**
@@ -143,12 +158,14 @@ inline void EigenDataSetLoader::validate_file_open() const
  * @return The normalized image data
  */
 
-inline Tensor EigenDataSetLoader::normalize_image_data(const std::vector<unsigned char> &data, int rows, int cols) const
+template <typename Scalar>
+inline BasicTensor<Scalar> EigenDataSetLoader::normalize_image_data(const std::vector<unsigned char> &data, int rows,
+                                                                    int cols) const
 {
-  Tensor images(1, rows * cols);
+  BasicTensor<Scalar> images(1, rows * cols);
   for (int i = 0; i < rows * cols; ++i)
   {
-    images(0, i) = static_cast<double>(data[i]) / 255.0;
+    images(0, i) = static_cast<Scalar>(static_cast<double>(data[i]) / 255.0);
   }
   return images;
 }
@@ -165,9 +182,11 @@ inline Tensor EigenDataSetLoader::normalize_image_data(const std::vector<unsigne
  * @return The one-hot encoded labels
  */
 
-inline Tensor EigenDataSetLoader::one_hot_encode_labels(const std::vector<unsigned char> &data, int numLabels) const
+template <typename Scalar>
+inline BasicTensor<Scalar> EigenDataSetLoader::one_hot_encode_labels(const std::vector<unsigned char> &data,
+                                                                     int numLabels) const
 {
-  Tensor labels = Tensor::Zero(data.size(), numLabels);
+  BasicTensor<Scalar> labels = BasicTensor<Scalar>::Zero(data.size(), numLabels);
   for (size_t i = 0; i < data.size(); ++i)
   {
     labels(i, data[i]) = 1.0;
@@ -181,10 +200,11 @@ inline Tensor EigenDataSetLoader::one_hot_encode_labels(const std::vector<unsign
  *
  * @brief Reads images from the dataset
  *
- * @return Tensor of images
+ * @return Row-major tensor of images, one image per row
  */
 
-inline Tensor EigenDataSetLoader::read_images()
+template <typename Scalar>
+inline BasicRowMajorTensor<Scalar> EigenDataSetLoader::read_images()
 {
   validate_file_open();
 
@@ -197,17 +217,84 @@ inline Tensor EigenDataSetLoader::read_images()
   int rows = read_big_endian_int();
   int cols = read_big_endian_int();
 
-  Tensor images(numImages, rows * cols);
+  BasicRowMajorTensor<Scalar> images(numImages, rows * cols);
 
   for (int i = 0; i < numImages; ++i)
   {
     auto rawData = read_bytes(rows * cols);
-    images.row(i) = normalize_image_data(rawData, rows, cols);
+    images.row(i) = normalize_image_data<Scalar>(rawData, rows, cols);
   }
 
   return images;
 }
 
+/**
+ * @brief Reads images from the dataset into a CSR matrix holding only the non-zero (normalized) pixels,
+ * @brief which is about a fifth of them for MNIST
+ *
+ * @return Sparse tensor of images, one row per image
+ */
+
+template <typename Scalar>
+inline BasicSparseTensor<Scalar> EigenDataSetLoader::read_images_sparse()
+{
+  validate_file_open();
+
+  if (read_big_endian_int() != 2051)
+  {
+    throw std::runtime_error("Error: Invalid file type (not a MNIST image file).");
+  }
+
+  int numImages = read_big_endian_int();
+  int rows = read_big_endian_int();
+  int cols = read_big_endian_int();
+
+  BasicSparseTensor<Scalar> images(numImages, rows * cols);
+  images.reserve(static_cast<Eigen::Index>(numImages) * rows * cols / 4);
+
+  for (int i = 0; i < numImages; ++i)
+  {
+    auto rawData = read_bytes(rows * cols);
+    images.startVec(i);
+    for (int j = 0; j < rows * cols; ++j)
+    {
+      if (rawData[j] != 0)
+      {
+        images.insertBack(i, j) = static_cast<Scalar>(static_cast<double>(rawData[j]) / 255.0);
+      }
+    }
+  }
+  images.finalize();
+
+  return images;
+}
+
+/**
+ * @brief Reads images from the dataset as stored, one byte per pixel, e.g. for the int8 inference model
+ *
+ * @return Tensor of raw pixels, one image per row
+ */
+
+inline PixelTensor EigenDataSetLoader::read_images_raw()
+{
+  validate_file_open();
+
+  if (read_big_endian_int() != 2051)
+  {
+    throw std::runtime_error("Error: Invalid file type (not a MNIST image file).");
+  }
+
+  int numImages = read_big_endian_int();
+  int rows = read_big_endian_int();
+  int cols = read_big_endian_int();
+
+  PixelTensor images(numImages, rows * cols);
+  auto rawData = read_bytes(static_cast<std::size_t>(numImages) * rows * cols);
+  std::copy(rawData.begin(), rawData.end(), images.data());
+
+  return images;
+}
+
 /**
  * @author Hamiz Ali
  * @since 24.01.2025
@@ -217,7 +304,8 @@ inline Tensor EigenDataSetLoader::read_images()
  * @return Tensor of one-hot encoded labels
  */
 
-inline Tensor EigenDataSetLoader::read_labels()
+template <typename Scalar>
+inline BasicTensor<Scalar> EigenDataSetLoader::read_labels()
 {
   validate_file_open();
 
@@ -230,5 +318,5 @@ inline Tensor EigenDataSetLoader::read_labels()
 
   auto rawData = read_bytes(numLabels);
 
-  return one_hot_encode_labels(rawData, 10);
+  return one_hot_encode_labels<Scalar>(rawData, 10);
 }
\ No newline at end of file
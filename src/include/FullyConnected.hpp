@@ -1,34 +1,195 @@
 #pragma once
 
 #include "BaseLayer.hpp"
+#include "Gemm.hpp"
 #include "Optimizers.hpp"
 #include "Initializers.hpp"
+#include "MixedPrecision.hpp"
+#include "ParameterArena.hpp"
 #include "Eigen/Dense"
+#include <algorithm>
+#include <concepts>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 using Tensor = Eigen::MatrixXd;
 
-class FullyConnected final : public BaseLayer
+/**
+ * @brief Fully connected layer. InputSize and OutputSize fix the layer shape at compile time (Eigen::Dynamic keeps
+ * @brief it a runtime property). Weight columns are then fixed-size Eigen vectors and the feature loops have constant
+ * @brief trip counts; small fixed-size layers (e.g. the 10-class head) process single samples with fully unrolled
+ * @brief column kernels instead of Eigen's GEMV, whose setup dominates at that size.
+ * @brief ReLUEpilogue fuses a ReLU activation into the layer: bias and max(0, .) are applied in one pass over the
+ * @brief product (in registers for the column kernels and the sparse path), and the backward pass masks the error
+ * @brief with the sign of the layer's own output, so neither a pre-activation tensor nor a ReLU layer is needed.
+ * @brief Scalar is the element type of weights, activations and errors (double or float). A float layer can train in
+ * @brief mixed precision (set_mixed_precision): the three batch products take bfloat16 operands with fp32
+ * @brief accumulation, while the weights, bias, gradients and optimizer state stay the fp32 master copies.
+ */
+template <int InputSize = Eigen::Dynamic, int OutputSize = Eigen::Dynamic, bool ReLUEpilogue = false,
+          typename Scalar = double>
+class BasicFullyConnected final : public BasicBaseLayer<Scalar>
 {
+public:
+    using Tensor = BasicTensor<Scalar>;
+    using SparseTensor = BasicSparseTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+    using ConstRowMajorTensorRef = BasicConstRowMajorTensorRef<Scalar>;
+    using Optimizer = BasicOptimizer<Scalar>;
+    using Initializer = BasicInitializer<Scalar>;
+
 private:
+    // Largest fixed output size for which the single-sample column kernels beat Eigen's GEMV
+    static constexpr bool UseColumnKernels = OutputSize != Eigen::Dynamic && OutputSize <= 128;
+
+    using Column = Eigen::Matrix<Scalar, OutputSize, 1>;
+    using ColumnMap = Eigen::Map<Column>;
+    using ConstColumnMap = Eigen::Map<const Column>;
+
     unsigned int input_size;
     unsigned int output_size;
+    // Steps the parameters of the layer in update_parameters(); null once they are bound to the arena of a network,
+    // which steps them itself
     Optimizer *optimizer;
+    // Weights, bias, their gradients and the optimizer state, until bind_parameters() moves them into another arena
+    BasicParameterArena<Scalar> own_parameters;
+    // Slot of the weights in the arena, followed by the bias
+    std::size_t parameter_slot = 0;
+    // Owned copy of the input for the allocating forward(); the buffer based one only keeps a view in input_ref
     Tensor input_tensor_cache;
-    Tensor input_tensor_w_bias;
+    std::optional<ConstTensorRef> input_ref;
+    // View of a row-major input batch, e.g. a row block of the dataset; replaces input_ref if row_major_input is set
+    std::optional<ConstRowMajorTensorRef> row_major_input_ref;
+    bool row_major_input = false;
+    // ReLUEpilogue only: the output of the last forward pass, whose positive entries are the ReLU mask, and the
+    // masked error of the backward pass
+    Tensor output_tensor_cache;
+    std::optional<ConstTensorRef> output_ref;
+    Tensor masked_error;
+    Eigen::Map<Tensor> gradient_weights{nullptr, 0, 0};
+    Eigen::Map<Tensor> gradient_bias{nullptr, 0, 0};
+    Tensor error_transposed;
+    // Packing buffers of the forward, weight gradient and propagated error products
+    BasicGemmWorkspace<Scalar> forward_gemm;
+    BasicGemmWorkspace<Scalar> gradient_gemm;
+    BasicGemmWorkspace<Scalar> error_gemm;
+    SparseTensor sparse_input_cache;
+    bool sparse_input = false;
+    // Sparse path only: the input features that are non-zero in the last batch, in ascending order, which are the
+    // only weight columns that get a gradient and an optimizer step; feature_active marks them while they are collected
+    std::vector<Eigen::Index> active_features;
+    std::vector<bool> feature_active;
+    std::vector<ParameterRange> active_ranges;
+    // The weight gradient is zero outside the columns of active_features, so a sparse backward pass only clears those
+    bool sparse_gradient = false;
+
+    // Mixed precision only: bfloat16 pair packings (see MixedPrecision.hpp) of the weights, repacked lazily after
+    // every update, and of the batch operands of the last forward and backward pass
+    bool mixed_precision = false;
+    bool weight_pairs_current = false;
+    bf16::PairTensor weight_pairs;
+    bf16::PairTensor weight_row_pairs;
+    bf16::PairTensor input_pairs;
+    bf16::PairTensor input_row_pairs;
+    bf16::PairTensor error_pairs;
+    bf16::PairTensor error_row_pairs;
+
+    Eigen::Index num_features() const
+    {
+        return InputSize == Eigen::Dynamic ? Eigen::Index(input_size) : Eigen::Index(InputSize);
+    }
+
+    ConstColumnMap weight_column(Eigen::Index feature) const
+    {
+        return ConstColumnMap(this->weights.data() + feature * output_size, output_size);
+    }
+
+    /**
+     * @brief Single-sample forward pass: bias + sum of x[k] * W[:, k], using two accumulators to hide the FMA latency
+     * @param input
+     * @param output
+     */
+    template <typename Input>
+    void forward_columns(const Input &input, TensorRef output) const
+    {
+        const Eigen::Index features = num_features();
+        Column acc0 = ConstColumnMap(bias.data(), output_size);
+        Column acc1 = Column::Zero(output_size);
+        Eigen::Index k = 0;
+        for (; k + 1 < features; k += 2)
+        {
+            acc0 += input(0, k) * weight_column(k);
+            acc1 += input(0, k + 1) * weight_column(k + 1);
+        }
+        for (; k < features; ++k)
+        {
+            acc0 += input(0, k) * weight_column(k);
+        }
+        if constexpr (ReLUEpilogue)
+        {
+            output.row(0) = (acc0 + acc1).cwiseMax(Scalar(0)).transpose();
+        }
+        else
+        {
+            output.row(0) = (acc0 + acc1).transpose();
+        }
+    }
+
+    /**
+     * @brief The error of the ReLU pre-activation: error where the output of the last forward pass is positive,
+     * @brief zero elsewhere. Without ReLUEpilogue the error is returned as is.
+     * @param error Error tensor from the successor layer
+     * @return ConstTensorRef View of error or of the masked_error workspace
+     */
+    ConstTensorRef relu_masked(const ConstTensorRef &error)
+    {
+        if constexpr (ReLUEpilogue)
+        {
+            if (masked_error.rows() < error.rows())
+            {
+                reserve(error.rows());
+            }
+            auto masked = masked_error.topRows(error.rows());
+            masked = (output_ref->array() > 0).select(error, Scalar(0));
+            return masked;
+        }
+        else
+        {
+            return error;
+        }
+    }
+
+    /**
+     * @brief Whether a batch takes the bfloat16 products. Smaller batches would mostly multiply tile padding.
+     * @param batch_size
+     * @return bool
+     */
+    bool use_mixed_precision(Eigen::Index batch_size) const
+    {
+        return mixed_precision && batch_size >= bf16::kTileSize;
+    }
 
 public:
-    FullyConnected(unsigned int input_size, unsigned int output_size, Optimizer *optimizer)
+    BasicFullyConnected(unsigned int input_size, unsigned int output_size, Optimizer *optimizer)
     {
+        eigen_assert((InputSize == Eigen::Dynamic || input_size == unsigned(InputSize)) &&
+                     (OutputSize == Eigen::Dynamic || output_size == unsigned(OutputSize)));
         this->input_size = input_size;
         this->output_size = output_size;
-        // Declare weights tensor size to include bias
-        this->weights = Tensor::Zero(this->input_size + 1, this->output_size);
         this->trainable = true;
         this->optimizer = optimizer;
+        add_parameters(own_parameters);
+        own_parameters.allocate(optimizer != nullptr ? optimizer->state_planes() : 0);
+        map_parameters(own_parameters);
     };
 
-    FullyConnected() {}
-    ~FullyConnected() {}
+    BasicFullyConnected() {}
+    // Movable into a pipeline (BasicSequential); not copyable, as a copy would step the optimizer state of this layer
+    BasicFullyConnected(BasicFullyConnected &&) = default;
+    ~BasicFullyConnected() {}
 
     /**
      * @author Hamiz Ali, Lam Tran
@@ -42,8 +203,73 @@ public:
         weights_initializer->initialize(input_size, output_size);
         bias_initializer->initialize(1, output_size);
 
-        this->weights.topRows(input_size) = weights_initializer->getWeights();
-        this->weights.bottomRows(1) = bias_initializer->getWeights();
+        this->weights = weights_initializer->getWeights().transpose();
+        this->bias = bias_initializer->getWeights().transpose();
+        weight_pairs_current = false;
+    }
+
+    /**
+     * @brief Add the weights and the bias to the arena of a network, before it is allocated
+     * @param arena
+     */
+    void add_parameters(BasicParameterArena<Scalar> &arena)
+    {
+        // Weights are stored output x input (like torch.nn.Linear), so that the weights of one input feature are a
+        // contiguous column
+        parameter_slot = arena.add(output_size, input_size);
+        arena.add(output_size, 1);
+    }
+
+    /**
+     * @brief Move the weights and the bias into the allocated arena they were added to. The owner of the arena steps
+     * @brief them from then on, once per backward pass, so the optimizer of the layer is no longer used.
+     * @param arena
+     */
+    void bind_parameters(BasicParameterArena<Scalar> &arena)
+    {
+        sparse_gradient = false;
+        arena.values(parameter_slot) = this->weights;
+        arena.values(parameter_slot + 1) = this->bias;
+        map_parameters(arena);
+        own_parameters = BasicParameterArena<Scalar>();
+        optimizer = nullptr;
+    }
+
+    /**
+     * @brief Slot of the weights in the arena the layer was added to
+     * @return std::size_t
+     */
+    std::size_t weights_slot() const
+    {
+        return parameter_slot;
+    }
+
+    /**
+     * @brief The input features that are non-zero in the last sparse batch, in ascending order: the only weight
+     * @brief columns with a gradient after its backward pass, which the optimizer steps alone
+     * @return std::span<const Eigen::Index>
+     */
+    std::span<const Eigen::Index> sparse_features() const
+    {
+        return active_features;
+    }
+
+    /**
+     * @brief Train batches of at least 16 samples in mixed precision: weights and batch operands are rounded to
+     * @brief bfloat16 for the forward, weight gradient and propagated error products, which accumulate in fp32.
+     * @brief Single samples, the column kernels and the sparse path stay fp32. Only for float layers.
+     * @param enabled
+     */
+    void set_mixed_precision(bool enabled)
+    {
+        static_assert(std::is_same_v<Scalar, float>, "mixed precision keeps float master weights");
+        mixed_precision = enabled;
+        weight_pairs_current = false;
+        if (enabled)
+        {
+            weight_pairs.resize(bf16::padded(bf16::pairs(input_size)), bf16::padded(output_size));
+            weight_row_pairs.resize(bf16::padded(bf16::pairs(output_size)), bf16::padded(input_size));
+        }
     }
 
     /**
@@ -56,12 +282,86 @@ public:
     Tensor forward(const Tensor &input_tensor) override
     {
         input_tensor_cache = input_tensor;
+        if constexpr (ReLUEpilogue)
+        {
+            // The output is the mask of the backward pass, so the layer keeps it
+            output_tensor_cache.resize(input_tensor.rows(), output_size);
+            forward(input_tensor_cache, output_tensor_cache);
+            return output_tensor_cache;
+        }
+        Tensor output(input_tensor.rows(), output_size);
+        forward(input_tensor_cache, output);
+        return output;
+    }
 
-        input_tensor_w_bias = Tensor::Zero(input_tensor.rows(), input_tensor.cols() + 1);
-        input_tensor_w_bias.leftCols(input_tensor.cols()) = input_tensor;
-        input_tensor_w_bias.rightCols(1).setOnes();
+    /**
+     * @brief Forward pass into a caller-provided buffer; keeps a view of the input for the backward pass
+     * @param input
+     * @param output
+     */
+    void forward(const ConstTensorRef &input, TensorRef output) override
+    {
+        sparse_input = false;
+        row_major_input = false;
+        input_ref.emplace(input);
+        forward_dense(input, output);
+    }
 
-        return input_tensor_w_bias * this->weights;
+    /**
+     * @brief Forward pass for a row-major input batch, e.g. a row block of the dataset, read in place. Only an exact
+     * @brief ConstRowMajorTensorRef selects this overload; every other dense argument binds the ConstTensorRef one.
+     * @param input
+     * @param output
+     */
+    template <std::same_as<ConstRowMajorTensorRef> RowMajorRef>
+    void forward(const RowMajorRef &input, TensorRef output)
+    {
+        sparse_input = false;
+        row_major_input = true;
+        row_major_input_ref.emplace(input);
+        forward_dense(input, output);
+    }
+
+    /**
+     * @brief Forward pass for a sparse (CSR) input batch, e.g. MNIST pixels of which ~80% are zero.
+     * @brief Only the weight columns of the non-zero features are gathered, each as one contiguous axpy.
+     * @param input_tensor
+     * @return Tensor
+     */
+    Tensor forward(const SparseTensor &input_tensor)
+    {
+        sparse_input = true;
+        sparse_input_cache = input_tensor;
+        sparse_input_cache.makeCompressed();
+
+        const Eigen::Index batch_size = sparse_input_cache.rows();
+        const auto *row_start = sparse_input_cache.outerIndexPtr();
+        const auto *feature = sparse_input_cache.innerIndexPtr();
+        const Scalar *value = sparse_input_cache.valuePtr();
+
+        // Computed transposed (output x batch) so that each sample accumulates into a contiguous column
+        Tensor output_transposed(output_size, batch_size);
+#pragma omp parallel for schedule(static)
+        for (Eigen::Index sample = 0; sample < batch_size; ++sample)
+        {
+            ColumnMap out(output_transposed.data() + sample * output_size, output_size);
+            out = ConstColumnMap(bias.data(), output_size);
+            for (auto nz = row_start[sample]; nz < row_start[sample + 1]; ++nz)
+            {
+                out += value[nz] * weight_column(feature[nz]);
+            }
+            if constexpr (ReLUEpilogue)
+            {
+                out = out.cwiseMax(Scalar(0));
+            }
+        }
+        if constexpr (ReLUEpilogue)
+        {
+            output_tensor_cache = output_transposed.transpose();
+            output_ref.emplace(output_tensor_cache);
+            return output_tensor_cache;
+        }
+        return output_transposed.transpose();
     }
 
     /**
@@ -73,9 +373,369 @@ public:
      */
     Tensor backward(const Tensor &error_tensor) override
     {
-        Tensor gradient_weights = input_tensor_w_bias.transpose() * error_tensor;
-        this->weights = optimizer->updateWeights(this->weights, gradient_weights);
-        Tensor weights_no_bias = this->weights.topRows(this->weights.rows() - 1);
-        return error_tensor * weights_no_bias.transpose();
+        if (sparse_input)
+        {
+            backward_sparse(relu_masked(error_tensor));
+            return Tensor();
+        }
+
+        Tensor error_prev(error_tensor.rows(), input_size);
+        backward(error_tensor, error_prev);
+        return error_prev;
+    }
+
+    /**
+     * @brief Backward pass into a caller-provided buffer. An empty error_prev skips the propagated error, e.g. for
+     * @brief the first layer, whose predecessor is the raw input.
+     * @param error_tensor
+     * @param error_prev
+     */
+    void backward(const ConstTensorRef &error_tensor, TensorRef error_prev) override
+    {
+        const ConstTensorRef error = relu_masked(error_tensor);
+        if (sparse_input)
+        {
+            backward_sparse(error);
+        }
+        else if (row_major_input)
+        {
+            sparse_gradient = false;
+            backward_dense(*row_major_input_ref, error, error_prev);
+        }
+        else
+        {
+            sparse_gradient = false;
+            backward_dense(*input_ref, error, error_prev);
+        }
+    }
+
+    void reserve(Eigen::Index max_batch_size) override
+    {
+        if constexpr (ReLUEpilogue)
+        {
+            masked_error.resize(std::max(max_batch_size, masked_error.rows()), output_size);
+        }
+        forward_gemm.reserve(max_batch_size, output_size, input_size);
+        gradient_gemm.reserve(output_size, input_size, max_batch_size);
+        error_gemm.reserve(max_batch_size, input_size, output_size);
+        if (mixed_precision && bf16::padded(max_batch_size) > input_pairs.rows())
+        {
+            const Eigen::Index batch = bf16::padded(max_batch_size);
+            input_pairs.resize(batch, bf16::padded(bf16::pairs(input_size)));
+            input_row_pairs.resize(bf16::padded(bf16::pairs(batch)), bf16::padded(input_size));
+            error_pairs.resize(batch, bf16::padded(bf16::pairs(output_size)));
+            error_row_pairs.resize(bf16::padded(output_size), bf16::padded(bf16::pairs(batch)));
+        }
+    }
+
+    Eigen::Index output_width(Eigen::Index input_width) const override
+    {
+        eigen_assert(input_width == Eigen::Index(input_size));
+        (void)input_width;
+        return OutputSize == Eigen::Dynamic ? Eigen::Index(output_size) : Eigen::Index(OutputSize);
+    }
+
+    Eigen::Map<Tensor> bias{nullptr, 0, 0};
+
+private:
+    /**
+     * @brief Forward pass of a dense batch in either layout
+     * @param input Batch x input features
+     * @param output
+     */
+    template <typename Input>
+    void forward_dense(const Input &input, TensorRef output)
+    {
+        if constexpr (ReLUEpilogue)
+        {
+            output_ref.emplace(output);
+        }
+
+        if constexpr (UseColumnKernels)
+        {
+            if (input.rows() == 1)
+            {
+                forward_columns(input, output);
+                return;
+            }
+        }
+        if (use_mixed_precision(input.rows()))
+        {
+            forward_mixed_precision(input, output);
+        }
+        else
+        {
+            gemm(output, input, this->weights.transpose(), forward_gemm);
+        }
+        // Eigen's GEMM has no epilogue hook, and splitting the product into tiles costs more in repacked weights
+        // than it saves, so bias and activation follow as a single pass
+        if constexpr (ReLUEpilogue)
+        {
+            output = (output.rowwise() + bias.col(0).transpose()).cwiseMax(Scalar(0));
+        }
+        else
+        {
+            output.rowwise() += bias.col(0).transpose();
+        }
+    }
+
+    /**
+     * @brief Backward pass after a dense forward pass, with the input of that pass in either layout
+     * @param input Batch x input features
+     * @param error Masked error tensor
+     * @param error_prev
+     */
+    template <typename Input>
+    void backward_dense(const Input &input, const ConstTensorRef &error, TensorRef error_prev)
+    {
+        if constexpr (UseColumnKernels)
+        {
+            if (error.rows() == 1)
+            {
+                backward_columns(input, error, error_prev);
+                return;
+            }
+        }
+        if (use_mixed_precision(error.rows()))
+        {
+            backward_mixed_precision(input, error, error_prev);
+            return;
+        }
+
+        // Both products read the cached input and the weights in place (transposed views, no copies). A single
+        // sample goes through Eigen's rank-1 update and GEMV kernels instead of degenerate GEMMs.
+        if (error.rows() == 1)
+        {
+            gradient_weights.noalias() = error.row(0).transpose() * input.row(0);
+        }
+        else
+        {
+            gemm(gradient_weights, error.transpose(), input, gradient_gemm);
+        }
+        gradient_bias = error.colwise().sum().transpose();
+
+        update_parameters();
+
+        if (error_prev.size() == 0)
+        {
+            return;
+        }
+        if (error.rows() == 1)
+        {
+            error_prev.row(0).noalias() = error.row(0) * this->weights;
+        }
+        else
+        {
+            gemm(error_prev, error, this->weights, error_gemm);
+        }
+    }
+
+    /**
+     * @brief Step the optimizer on the weights and the bias, in place, with the gradients of the last backward pass,
+     * @brief in one pass over the arena of the layer. Bound to the arena of a network, the network steps them after
+     * @brief the backward pass instead.
+     */
+    void update_parameters()
+    {
+        if (optimizer != nullptr)
+        {
+            const typename Optimizer::Parameter parameter =
+                sparse_input ? own_parameters.parameter(parameter_slot, active_features, active_ranges)
+                             : own_parameters.parameter();
+            optimizer->step(typename Optimizer::ParamGroup(&parameter, 1));
+        }
+        weight_pairs_current = false;
+    }
+
+    /**
+     * @brief Point the weights, the bias and their gradients to their slots in the arena
+     * @param arena
+     */
+    void map_parameters(BasicParameterArena<Scalar> &arena)
+    {
+        new (&this->weights) Eigen::Map<Tensor>(arena.values(parameter_slot));
+        new (&bias) Eigen::Map<Tensor>(arena.values(parameter_slot + 1));
+        new (&gradient_weights) Eigen::Map<Tensor>(arena.gradient(parameter_slot));
+        new (&gradient_bias) Eigen::Map<Tensor>(arena.gradient(parameter_slot + 1));
+    }
+
+    /**
+     * @brief output = input * W^T with bfloat16 operands and fp32 accumulation, computed as out(b, n) = sum over the
+     * @brief feature pairs q of (W(n, 2q), W(n, 2q + 1)) . (x(b, 2q), x(b, 2q + 1)). The weights are repacked only
+     * @brief when they changed since the last pass.
+     * @param input
+     * @param output
+     */
+    template <typename Input>
+    void forward_mixed_precision(const Input &input, TensorRef output)
+    {
+        if constexpr (std::is_same_v<Scalar, float>)
+        {
+            if (bf16::padded(input.rows()) > input_pairs.rows())
+            {
+                reserve(input.rows());
+            }
+            if (!weight_pairs_current)
+            {
+                bf16::pack_column_pairs_transposed(this->weights.data(), output_size, output_size, input_size,
+                                                   weight_pairs);
+                weight_pairs_current = true;
+            }
+            if constexpr (Input::IsRowMajor)
+            {
+                // The pairs along the rows of the column-major transpose
+                bf16::pack_row_pairs_transposed(input.data(), input.outerStride(), input_size, input.rows(),
+                                                input_pairs);
+            }
+            else
+            {
+                bf16::pack_column_pairs(input.data(), input.outerStride(), input.rows(), input_size, input_pairs);
+            }
+            bf16::gemm(weight_pairs, input_pairs, bf16::padded(bf16::pairs(input_size)), output_size, input.rows(),
+                       output.data(), output.outerStride());
+        }
+    }
+
+    /**
+     * @brief Backward pass with bfloat16 operands: the weight gradient error^T * input pairs up samples, the
+     * @brief propagated error error * W pairs up outputs of the weights. The bias gradient is summed in fp32.
+     * @param input Input of the forward pass
+     * @param error Masked error tensor
+     * @param error_prev
+     */
+    template <typename Input>
+    void backward_mixed_precision(const Input &input, const ConstTensorRef &error, TensorRef error_prev)
+    {
+        if constexpr (std::is_same_v<Scalar, float>)
+        {
+            const Eigen::Index batch_size = error.rows();
+            if (bf16::padded(batch_size) > input_pairs.rows())
+            {
+                reserve(batch_size);
+            }
+            if constexpr (Input::IsRowMajor)
+            {
+                bf16::pack_column_pairs_transposed(input.data(), input.outerStride(), input_size, batch_size,
+                                                   input_row_pairs);
+            }
+            else
+            {
+                bf16::pack_row_pairs(input.data(), input.outerStride(), batch_size, input_size, input_row_pairs);
+            }
+            bf16::pack_row_pairs_transposed(error.data(), error.outerStride(), batch_size, output_size,
+                                            error_row_pairs);
+            bf16::gemm(input_row_pairs, error_row_pairs, bf16::padded(bf16::pairs(batch_size)), input_size,
+                       output_size, gradient_weights.data(), output_size);
+            gradient_bias = error.colwise().sum().transpose();
+
+            update_parameters();
+
+            if (error_prev.size() == 0)
+            {
+                return;
+            }
+            bf16::pack_row_pairs(this->weights.data(), output_size, output_size, input_size, weight_row_pairs);
+            bf16::pack_column_pairs(error.data(), error.outerStride(), batch_size, output_size, error_pairs);
+            bf16::gemm(weight_row_pairs, error_pairs, bf16::padded(bf16::pairs(output_size)), input_size, batch_size,
+                       error_prev.data(), error_prev.outerStride());
+        }
+    }
+
+    /**
+     * @brief Single-sample backward pass of a small fixed-size layer: every gradient column is x[k] * error and every
+     * @brief propagated error entry the dot product of a weight column with the error, both on register-sized columns
+     * @param input Input of the forward pass
+     * @param error_tensor
+     * @param error_prev
+     */
+    template <typename Input>
+    void backward_columns(const Input &input, const ConstTensorRef &error_tensor, TensorRef error_prev)
+    {
+        const Eigen::Index features = num_features();
+        const Column error = error_tensor.row(0).transpose();
+
+        for (Eigen::Index k = 0; k < features; ++k)
+        {
+            ColumnMap(gradient_weights.data() + k * output_size, output_size) = input(0, k) * error;
+        }
+        gradient_bias = error;
+
+        update_parameters();
+
+        if (error_prev.size() == 0)
+        {
+            return;
+        }
+        for (Eigen::Index k = 0; k < features; ++k)
+        {
+            error_prev(0, k) = weight_column(k).dot(error);
+        }
+    }
+
+    /**
+     * @brief Backward pass after a sparse forward pass. Only the weight columns of features that are non-zero in the
+     * @brief batch receive a gradient, only they are cleared beforehand, and the optimizer steps only them (lazily,
+     * @brief see BasicParameter::ranges). A sparse input is raw data without a predecessor layer, so no error tensor
+     * @brief is propagated.
+     * @param error_tensor
+     */
+    void backward_sparse(const ConstTensorRef &error_tensor)
+    {
+        const Eigen::Index batch_size = sparse_input_cache.rows();
+        const auto *row_start = sparse_input_cache.outerIndexPtr();
+        const auto *feature = sparse_input_cache.innerIndexPtr();
+        const Scalar *value = sparse_input_cache.valuePtr();
+
+        // Output x batch, so that every sample's error is a contiguous column
+        error_transposed = error_tensor.transpose();
+
+        // Clear the gradient columns of the previous batch (all of them after a dense one), then collect the features
+        // of this batch and clear theirs
+        auto gradient_column = [&](Eigen::Index k) {
+            return ColumnMap(gradient_weights.data() + k * output_size, output_size);
+        };
+        if (sparse_gradient)
+        {
+            for (const Eigen::Index k : active_features)
+            {
+                gradient_column(k).setZero();
+            }
+        }
+        else
+        {
+            gradient_weights.setZero();
+            sparse_gradient = true;
+        }
+        feature_active.assign(num_features(), false);
+        for (auto nz = row_start[0]; nz < row_start[batch_size]; ++nz)
+        {
+            feature_active[feature[nz]] = true;
+        }
+        active_features.clear();
+        for (Eigen::Index k = 0; k < num_features(); ++k)
+        {
+            if (feature_active[k])
+            {
+                active_features.push_back(k);
+                gradient_column(k).setZero();
+            }
+        }
+
+        for (Eigen::Index sample = 0; sample < batch_size; ++sample)
+        {
+            const ConstColumnMap error(error_transposed.data() + sample * output_size, output_size);
+            for (auto nz = row_start[sample]; nz < row_start[sample + 1]; ++nz)
+            {
+                gradient_column(feature[nz]) += value[nz] * error;
+            }
+        }
+        gradient_bias = error_transposed.rowwise().sum();
+
+        update_parameters();
     }
 };
+
+// Layer with both sizes chosen at runtime
+using FullyConnected = BasicFullyConnected<>;
+// Layer with both sizes chosen at runtime, followed by a fused ReLU activation
+using FullyConnectedReLU = BasicFullyConnected<Eigen::Dynamic, Eigen::Dynamic, true>;
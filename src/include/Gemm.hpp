@@ -0,0 +1,140 @@
+#pragma once
+
+#include "BaseLayer.hpp"
+#include "Eigen/Dense"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * @brief Packing buffers of Eigen's GEMM kernel, one set per thread, allocated once by reserve() so that gemm() does
+ * @brief not allocate. Eigen's own product packs into a stack buffer up to EIGEN_STACK_ALLOCATION_LIMIT (128 KiB) and
+ * @brief heap-allocates above it, which the layer products of a training step exceed (e.g. 100 x 784 x 500).
+ * @brief The block sizes follow Eigen's cache heuristics for the reserved shape; smaller products reuse them.
+ */
+template <typename Scalar = double>
+class BasicGemmWorkspace
+{
+    using Blocking = Eigen::internal::gemm_blocking_space<Eigen::ColMajor, Scalar, Scalar, Eigen::Dynamic,
+                                                          Eigen::Dynamic, Eigen::Dynamic>;
+
+    std::vector<std::unique_ptr<Blocking>> blockings;
+    Eigen::Index reserved_rows = 0;
+    Eigen::Index reserved_cols = 0;
+    Eigen::Index reserved_depth = 0;
+
+    template <typename Dst, typename Lhs, typename Rhs>
+    friend void gemm(Dst &&dst, const Lhs &lhs, const Rhs &rhs, BasicGemmWorkspace<typename Lhs::Scalar> &workspace);
+
+public:
+    // Columns of the packed right-hand side panels, the granularity of the split across threads
+    static constexpr Eigen::Index PANEL_COLS = Eigen::internal::gebp_traits<Scalar, Scalar>::nr;
+
+    /**
+     * @brief Allocate the packing buffers for products of up to rows x depth times depth x cols, for the number of
+     * @brief OpenMP threads. Does nothing if they already cover the shape.
+     * @param rows
+     * @param cols
+     * @param depth
+     */
+    void reserve(Eigen::Index rows, Eigen::Index cols, Eigen::Index depth)
+    {
+#ifdef _OPENMP
+        const Eigen::Index threads = omp_get_max_threads();
+#else
+        const Eigen::Index threads = 1;
+#endif
+        if (rows <= reserved_rows && cols <= reserved_cols && depth <= reserved_depth &&
+            Eigen::Index(blockings.size()) == threads)
+        {
+            return;
+        }
+        reserved_rows = std::max(rows, reserved_rows);
+        reserved_cols = std::max(cols, reserved_cols);
+        reserved_depth = std::max(depth, reserved_depth);
+
+        // Every thread multiplies the whole left-hand side with its share of the columns
+        const Eigen::Index thread_cols = std::max(
+            PANEL_COLS, (reserved_cols + threads - 1) / threads + PANEL_COLS - 1) / PANEL_COLS * PANEL_COLS;
+        blockings.clear();
+        for (Eigen::Index thread = 0; thread < threads; ++thread)
+        {
+            blockings.push_back(std::make_unique<Blocking>(reserved_rows, thread_cols, reserved_depth, 1, true));
+            blockings.back()->allocateAll();
+        }
+    }
+};
+
+using GemmWorkspace = BasicGemmWorkspace<double>;
+
+/**
+ * @brief dst = lhs * rhs with Eigen's GEMM kernel on the packing buffers of the workspace, so it does not allocate
+ * @brief once the workspace is reserved for the shape (an unreserved one is sized on the first call). Large products
+ * @brief split the columns of dst across the OpenMP threads. The operands are plain tensors, maps, refs, blocks of
+ * @brief them or their transposes, in either storage order; dst is column-major. Vector shapes take Eigen's GEMV.
+ * @param dst
+ * @param lhs
+ * @param rhs
+ * @param workspace
+ */
+template <typename Dst, typename Lhs, typename Rhs>
+void gemm(Dst &&dst, const Lhs &lhs, const Rhs &rhs, BasicGemmWorkspace<typename Lhs::Scalar> &workspace)
+{
+    using Scalar = typename Lhs::Scalar;
+    using Workspace = BasicGemmWorkspace<Scalar>;
+    using DstType = std::remove_cvref_t<Dst>;
+    static_assert(!(DstType::Flags & Eigen::RowMajorBit), "gemm() writes a column-major result");
+    constexpr int LhsOrder = (Lhs::Flags & Eigen::RowMajorBit) ? Eigen::RowMajor : Eigen::ColMajor;
+    constexpr int RhsOrder = (Rhs::Flags & Eigen::RowMajorBit) ? Eigen::RowMajor : Eigen::ColMajor;
+    using Kernel = Eigen::internal::general_matrix_matrix_product<Eigen::Index, Scalar, LhsOrder, false, Scalar,
+                                                                  RhsOrder, false, Eigen::ColMajor, 1>;
+
+    const Eigen::Index rows = lhs.rows();
+    const Eigen::Index cols = rhs.cols();
+    const Eigen::Index depth = lhs.cols();
+    eigen_assert(rhs.rows() == depth && dst.rows() == rows && dst.cols() == cols);
+    eigen_assert(lhs.innerStride() == 1 && rhs.innerStride() == 1 && dst.innerStride() == 1);
+
+    // Where Eigen itself would not run its GEMM kernel
+    if (rows == 1 || cols == 1 || depth == 0 || rows + cols + depth < EIGEN_GEMM_TO_COEFFBASED_THRESHOLD)
+    {
+        dst.noalias() = lhs * rhs;
+        return;
+    }
+    if (workspace.blockings.empty())
+    {
+        workspace.reserve(rows, cols, depth);
+    }
+
+    // At least one panel of columns and 50000 multiply-adds per thread, like Eigen's parallel GEMM
+    Eigen::Index threads = std::min<Eigen::Index>(
+        {Eigen::Index(workspace.blockings.size()), std::max<Eigen::Index>(1, cols / Workspace::PANEL_COLS),
+         std::max<Eigen::Index>(1, Eigen::Index(double(rows) * double(cols) * double(depth) / 50000))});
+#ifdef _OPENMP
+    if (omp_in_parallel())
+    {
+        threads = 1;
+    }
+#endif
+    const Eigen::Index thread_cols =
+        ((cols + threads - 1) / threads + Workspace::PANEL_COLS - 1) / Workspace::PANEL_COLS * Workspace::PANEL_COLS;
+
+    dst.setZero();
+#pragma omp parallel for num_threads(threads) schedule(static) if (threads > 1)
+    for (Eigen::Index thread = 0; thread < threads; ++thread)
+    {
+        const Eigen::Index first = thread * thread_cols;
+        const Eigen::Index count = std::min(cols, first + thread_cols) - first;
+        if (count <= 0)
+        {
+            continue;
+        }
+        const Scalar *rhs_panel = rhs.data() + (RhsOrder == Eigen::ColMajor ? first * rhs.outerStride() : first);
+        Kernel::run(rows, count, depth, lhs.data(), lhs.outerStride(), rhs_panel, rhs.outerStride(),
+                    dst.data() + first * dst.outerStride(), 1, dst.outerStride(), Scalar(1), *workspace.blockings[thread]);
+    }
+}
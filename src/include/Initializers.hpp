@@ -1,19 +1,46 @@
 #pragma once
 
+#include "BaseLayer.hpp"
 #include "Eigen/Dense"
-#include <random>
+#include "Philox.hpp"
+#include <cmath>
+#include <cstdint>
 
 using Tensor = Eigen::MatrixXd;
 
-class Initializer
+/**
+ * @brief Weight initializer for tensors of the given scalar type. Samples are drawn in double, so a float network
+ * @brief starts from the rounded weights of the double one. Every initialize() call draws from its own Philox stream
+ * @brief of the seed, so e.g. the layers sharing an initializer get independent weights that do not depend on the
+ * @brief number of threads filling them.
+ */
+template <typename Scalar = double>
+class BasicInitializer
 {
+public:
+    using Tensor = BasicTensor<Scalar>;
+
 protected:
     unsigned int seed;
+    // Philox stream of the next initialize() call
+    std::uint64_t stream = 0;
     Tensor weights;
 
+    /**
+     * @brief Draw fan_in x fan_out weights from N(0, sigma^2) on the next stream
+     * @param fan_in
+     * @param fan_out
+     * @param sigma
+     */
+    void sample_normal(unsigned int fan_in, unsigned int fan_out, double sigma)
+    {
+        weights.resize(fan_in, fan_out);
+        philox::fill_normal(seed, stream++, sigma, weights.data(), weights.size());
+    }
+
 public:
-    Initializer(unsigned int seed = 0) : seed(seed) {}
-    virtual ~Initializer() = default;
+    BasicInitializer(unsigned int seed = 0) : seed(seed) {}
+    virtual ~BasicInitializer() = default;
 
     // Pure virtual function for weight initialization
     virtual void initialize(unsigned int fan_in, unsigned int fan_out) = 0;
@@ -24,13 +51,13 @@ public:
     }
 };
 
-class Xavier final : public Initializer
+template <typename Scalar = double>
+class BasicXavier final : public BasicInitializer<Scalar>
 {
-private:
-    std::mt19937 gen;
-
 public:
-    Xavier(unsigned int seed = 0) : Initializer(seed), gen(seed) {}
+    using Tensor = BasicTensor<Scalar>;
+
+    BasicXavier(unsigned int seed = 0) : BasicInitializer<Scalar>(seed) {}
 
     /**
      * @author Lam Tran, Hamiz Ali
@@ -41,21 +68,17 @@ public:
      */
     void initialize(unsigned int fan_in, unsigned int fan_out) override
     {
-        weights = Tensor::Zero(fan_in, fan_out);
-        const double sigma = std::sqrt(2.0 / (fan_in + fan_out));
-        std::normal_distribution<double> distribution(0.0, sigma);
-
-        weights = Tensor::NullaryExpr(fan_in, fan_out, [&]() { return distribution(gen); });
+        this->sample_normal(fan_in, fan_out, std::sqrt(2.0 / (fan_in + fan_out)));
     }
 };
 
-class He final : public Initializer
+template <typename Scalar = double>
+class BasicHe final : public BasicInitializer<Scalar>
 {
-private:
-    std::mt19937 gen;
-
 public:
-    He(unsigned int seed = 0) : Initializer(seed), gen(seed) {}
+    using Tensor = BasicTensor<Scalar>;
+
+    BasicHe(unsigned int seed = 0) : BasicInitializer<Scalar>(seed) {}
 
     /**
      * @author Lam Tran, Hamiz Ali
@@ -66,10 +89,10 @@ public:
      */
     void initialize(unsigned int fan_in, unsigned int fan_out) override
     {
-        weights = Tensor::Zero(fan_in, fan_out);
-        const double sigma = std::sqrt(2.0 / fan_in);
-        std::normal_distribution<double> distribution(0.0, sigma);
-
-        weights = Tensor::NullaryExpr(fan_in, fan_out, [&]() { return distribution(gen); });
+        this->sample_normal(fan_in, fan_out, std::sqrt(2.0 / fan_in));
     }
-};
\ No newline at end of file
+};
+
+using Initializer = BasicInitializer<>;
+using Xavier = BasicXavier<>;
+using He = BasicHe<>;
@@ -0,0 +1,15 @@
+#pragma once
+
+// The x86 SIMD intrinsics, for the kernels that select an AVX2 or AVX-512 variant at runtime (X86_KERNELS).
+// GCC 12 reports the _mm*_undefined_*() idiom inside its AVX-512 intrinsics as -Wmaybe-uninitialized and
+// -Wuninitialized wherever they are inlined (GCC bug 105593). The reports point into the intrinsic headers, so
+// suppressing the warnings around their inclusion covers exactly these false positives, in our kernels as well as in
+// Eigen's packet math. Include this header before Eigen, which includes <immintrin.h> itself.
+#if defined(__x86_64__) || defined(__i386__)
+#define X86_KERNELS
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#endif
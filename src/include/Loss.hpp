@@ -3,19 +3,29 @@
 #include "BaseLayer.hpp"
 #include "Eigen/Dense"
 #include <iostream>
+#include <optional>
 
 #define EPSILON 1e-10
 
 using Tensor = Eigen::MatrixXd;
 
-class CrossEntropyLoss final : public BaseLayer
+template <typename Scalar = double>
+class BasicCrossEntropyLoss final : public BasicBaseLayer<Scalar>
 {
+public:
+    using Tensor = BasicTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+
 private:
+    // Owned prediction of the allocating API; the buffer based computed_loss() only keeps a view in prediction_ref
     Tensor prediction_tensor;
+    // Prediction of the last computed_loss() call, read by backward()
+    std::optional<ConstTensorRef> prediction_ref;
 
 public:
-    CrossEntropyLoss() : BaseLayer() {}
-    ~CrossEntropyLoss() {}
+    BasicCrossEntropyLoss() : BasicBaseLayer<Scalar>() {}
+    ~BasicCrossEntropyLoss() {}
 
     /**
      * @author Lam Tran
@@ -26,10 +36,11 @@ public:
      */
     Tensor forward(const Tensor &label_tensor) override
     {
-        double loss = computed_loss(this->prediction_tensor, label_tensor);
+        eigen_assert(this->prediction_ref && "computed_loss() must run before forward()");
+        double loss = loss_of(*this->prediction_ref, label_tensor);
         std::cout << "Loss: " << loss << std::endl;
         Tensor loss_tensor(1, 1);
-        loss_tensor(0, 0) = loss;
+        loss_tensor(0, 0) = Scalar(loss);
         return loss_tensor;
     }
 
@@ -44,7 +55,21 @@ public:
     double computed_loss(const Tensor &prediction_tensor, const Tensor &label_tensor)
     {
         this->prediction_tensor = prediction_tensor;
-        return -(label_tensor.array() * (prediction_tensor.array() + EPSILON).log()).sum();
+        this->prediction_ref.emplace(this->prediction_tensor);
+        return loss_of(prediction_tensor, label_tensor);
+    }
+
+    /**
+     * @brief Compute the loss of a prediction in a caller-provided buffer, e.g. a row block of a workspace.
+     * @brief The prediction is kept as a view for the buffer based backward(), so it must stay alive until then
+     * @param prediction_tensor Prediction tensor from the predecessor layer
+     * @param label_tensor
+     * @return double
+     */
+    double computed_loss(const ConstTensorRef &prediction_tensor, const ConstTensorRef &label_tensor)
+    {
+        this->prediction_ref.emplace(prediction_tensor);
+        return loss_of(prediction_tensor, label_tensor);
     }
 
     /**
@@ -56,6 +81,26 @@ public:
      */
     Tensor backward(const Tensor &label_tensor) override
     {
-        return -label_tensor.array() / (this->prediction_tensor.array() + EPSILON);
+        eigen_assert(this->prediction_ref && "computed_loss() must run before backward()");
+        return -label_tensor.array() / (this->prediction_ref->array() + Scalar(EPSILON));
     }
-};
\ No newline at end of file
+
+    /**
+     * @brief Compute the initial error tensor into a caller-provided buffer
+     * @param label_tensor Label tensor from successor layer
+     * @param error_tensor
+     */
+    void backward(const ConstTensorRef &label_tensor, TensorRef error_tensor) override
+    {
+        eigen_assert(this->prediction_ref && "computed_loss() must run before backward()");
+        error_tensor = -label_tensor.array() / (this->prediction_ref->array() + Scalar(EPSILON));
+    }
+
+private:
+    static double loss_of(const ConstTensorRef &prediction_tensor, const ConstTensorRef &label_tensor)
+    {
+        return -(label_tensor.array() * (prediction_tensor.array() + Scalar(EPSILON)).log()).sum();
+    }
+};
+
+using CrossEntropyLoss = BasicCrossEntropyLoss<>;
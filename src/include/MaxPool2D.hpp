@@ -0,0 +1,157 @@
+#pragma once
+
+#include "BaseLayer.hpp"
+#include "Eigen/Dense"
+#include <algorithm>
+
+using Tensor = Eigen::MatrixXd;
+
+/**
+ * @brief Max pooling over non-overlapping pool_size x pool_size windows of channels x height x width feature maps,
+ * @brief stored one sample per row in channel-major order (see Conv2D). Rows and columns that do not fill a window are
+ * @brief dropped. The forward pass records the input feature of every maximum, so the backward pass routes the error
+ * @brief by index without reading the input again.
+ */
+template <typename Scalar = double>
+class BasicMaxPool2D final : public BasicBaseLayer<Scalar>
+{
+public:
+    using Tensor = BasicTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+    using IndexTensor = Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic>;
+
+private:
+    Eigen::Index channels;
+    Eigen::Index height;
+    Eigen::Index width;
+    Eigen::Index pool_size;
+    Eigen::Index out_height;
+    Eigen::Index out_width;
+    // Batch x output features: the input feature holding the maximum of the window
+    IndexTensor argmax;
+    Tensor output_tensor_cache;
+
+public:
+    BasicMaxPool2D(Eigen::Index channels, Eigen::Index height, Eigen::Index width, Eigen::Index pool_size = 2)
+        : BasicBaseLayer<Scalar>(), channels(channels), height(height), width(width), pool_size(pool_size),
+          out_height(height / pool_size), out_width(width / pool_size)
+    {
+    }
+    ~BasicMaxPool2D() {}
+
+    /**
+     * @brief Forward pass through the pooling layer
+     * @param input_tensor Input tensor from the predecessor layer
+     * @return Tensor
+     */
+    Tensor forward(const Tensor &input_tensor) override
+    {
+        output_tensor_cache.resize(input_tensor.rows(), channels * out_height * out_width);
+        forward(input_tensor, output_tensor_cache);
+        return output_tensor_cache;
+    }
+
+    /**
+     * @brief Backward pass through the pooling layer
+     * @param error_tensor Error tensor from the successor layer
+     * @return Tensor
+     */
+    Tensor backward(const Tensor &error_tensor) override
+    {
+        Tensor error_prev(error_tensor.rows(), channels * height * width);
+        backward(error_tensor, error_prev);
+        return error_prev;
+    }
+
+    /**
+     * @brief Window maxima into a caller-provided buffer. Each output column is reduced over the input columns of its
+     * @brief window, vectorized over the batch, keeping the index of the first maximum.
+     * @param input Batch x (channels * height * width)
+     * @param output Batch x (channels * out_height * out_width)
+     */
+    void forward(const ConstTensorRef &input, TensorRef output) override
+    {
+        const Eigen::Index batch_size = input.rows();
+        if (batch_size > argmax.rows())
+        {
+            reserve(batch_size);
+        }
+
+        for (Eigen::Index channel = 0, feature = 0; channel < channels; ++channel)
+        {
+            for (Eigen::Index out_row = 0; out_row < out_height; ++out_row)
+            {
+                for (Eigen::Index out_col = 0; out_col < out_width; ++out_col, ++feature)
+                {
+                    auto maximum = output.col(feature);
+                    auto index = argmax.col(feature).head(batch_size);
+                    const int first = int((channel * height + out_row * pool_size) * width + out_col * pool_size);
+                    maximum = input.col(first);
+                    index.setConstant(first);
+                    for (Eigen::Index row = 0; row < pool_size; ++row)
+                    {
+                        for (Eigen::Index col = row == 0 ? 1 : 0; col < pool_size; ++col)
+                        {
+                            const int candidate = first + int(row * width + col);
+                            index = (input.col(candidate).array() > maximum.array()).select(candidate, index);
+                            maximum = maximum.cwiseMax(input.col(candidate));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Route the error of every window to its maximum, zero elsewhere. As the windows do not overlap, every input
+     * @brief column is written once, vectorized over the batch like the forward pass, instead of zeroing the whole
+     * @brief tensor and scattering into it.
+     * @param error Error tensor from the successor layer
+     * @param error_prev
+     */
+    void backward(const ConstTensorRef &error, TensorRef error_prev) override
+    {
+        const Eigen::Index batch_size = error.rows();
+        if (height % pool_size != 0 || width % pool_size != 0)
+        {
+            // Rows and columns outside every window get no error
+            error_prev.setZero();
+        }
+
+        for (Eigen::Index channel = 0, feature = 0; channel < channels; ++channel)
+        {
+            for (Eigen::Index out_row = 0; out_row < out_height; ++out_row)
+            {
+                for (Eigen::Index out_col = 0; out_col < out_width; ++out_col, ++feature)
+                {
+                    const auto index = argmax.col(feature).head(batch_size);
+                    const int first = int((channel * height + out_row * pool_size) * width + out_col * pool_size);
+                    for (Eigen::Index row = 0; row < pool_size; ++row)
+                    {
+                        for (Eigen::Index col = 0; col < pool_size; ++col)
+                        {
+                            const int candidate = first + int(row * width + col);
+                            error_prev.col(candidate) =
+                                (index.array() == candidate).select(error.col(feature), Scalar(0));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void reserve(Eigen::Index max_batch_size) override
+    {
+        argmax.resize(std::max(max_batch_size, argmax.rows()), channels * out_height * out_width);
+    }
+
+    Eigen::Index output_width(Eigen::Index input_width) const override
+    {
+        eigen_assert(input_width == channels * height * width);
+        (void)input_width;
+        return channels * out_height * out_width;
+    }
+};
+
+using MaxPool2D = BasicMaxPool2D<>;
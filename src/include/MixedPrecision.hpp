@@ -0,0 +1,705 @@
+#pragma once
+
+#include "Intrinsics.hpp"
+#include "Eigen/Dense"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+// AMX tiles are used if the CPU has them and Linux grants the process the tile data state
+#if defined(X86_KERNELS) && defined(__linux__)
+#define MIXED_PRECISION_AMX 1
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief bfloat16 products with fp32 accumulation for the mixed precision layers: AMX tiles if available, otherwise
+ * @brief AVX-512 (vdpbf16ps with AVX512-BF16, emulated with FMAs without) or a scalar loop, chosen at runtime.
+ * @brief Operands are PairTensors of 32-bit words that each hold two bfloat16 values, the low half first, which is
+ * @brief the operand format of both the tile and the vector dot product instructions. gemm() multiplies an operand in
+ * @brief pair-major layout, entry (q, r) = pair q of row r, with one in vector-major layout, entry (v, q) = pair q of
+ * @brief column v. Both dimensions of either layout are padded to multiples of kTileSize with zeros by the pack
+ * @brief functions, which convert column-major float matrices with round to nearest even.
+ */
+namespace bf16
+{
+
+using PairTensor = Eigen::Matrix<std::uint32_t, Eigen::Dynamic, Eigen::Dynamic>;
+
+// Rows and 32-bit columns of an AMX tile, and the float lanes of an AVX-512 vector
+inline constexpr Eigen::Index kTileSize = 16;
+// Register block of the AVX-512 kernel: kBlockRows broadcast pairs times kBlockVectors vectors (24 zmm accumulators)
+inline constexpr int kBlockRows = 6;
+inline constexpr int kBlockVectors = 4;
+// Pairs per pass of the AVX-512 kernel, so that its panel of the vector-major operand (16 KiB) stays in L1
+inline constexpr Eigen::Index kDepthBlock = 64;
+
+inline Eigen::Index padded(Eigen::Index size)
+{
+    return (size + kTileSize - 1) / kTileSize * kTileSize;
+}
+
+inline Eigen::Index pairs(Eigen::Index size)
+{
+    return (size + 1) / 2;
+}
+
+/**
+ * @brief Round to the nearest bfloat16 (ties to even), returned in the upper half of the float's bit pattern
+ * @param x
+ * @return std::uint32_t
+ */
+inline std::uint32_t round_to_bfloat16(float x)
+{
+    const std::uint32_t bits = std::bit_cast<std::uint32_t>(x);
+    return (bits + 0x7FFF + ((bits >> 16) & 1)) & 0xFFFF0000;
+}
+
+/**
+ * @brief Whether gemm() runs on AMX tiles. The first call asks Linux for the tile data state.
+ * @return bool
+ */
+inline bool amx_available()
+{
+#if defined(MIXED_PRECISION_AMX)
+    // ARCH_REQ_XCOMP_PERM for XFEATURE_XTILEDATA
+    static const bool granted = __builtin_cpu_supports("amx-tile") && __builtin_cpu_supports("amx-bf16") &&
+                                syscall(SYS_arch_prctl, 0x1023, 18) == 0;
+    return granted;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Whether the CPU has the AVX-512 instructions of the vector kernels, and the bfloat16 dot product among them
+ * @return bool
+ */
+inline bool avx512_available()
+{
+#if defined(X86_KERNELS)
+    return __builtin_cpu_supports("avx512f");
+#else
+    return false;
+#endif
+}
+
+inline bool avx512_bf16_available()
+{
+#if defined(X86_KERNELS)
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bf16");
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Name of the instructions gemm() uses, for the training log
+ * @return const char*
+ */
+inline const char *kernel_name()
+{
+    if (amx_available())
+    {
+        return "AMX-BF16";
+    }
+    if (avx512_bf16_available())
+    {
+        return "AVX512-BF16";
+    }
+    if (avx512_available())
+    {
+        return "AVX-512 (emulated bfloat16)";
+    }
+    return "scalar (emulated bfloat16)";
+}
+
+namespace detail
+{
+
+#if defined(X86_KERNELS)
+// The AVX-512 kernels are compiled for it whatever -march says, and only called if avx512_available()
+
+__attribute__((target("avx512f"))) inline __m512i round_to_bfloat16(__m512 x)
+{
+    const __m512i bits = _mm512_castps_si512(x);
+    const __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+    const __m512i rounded = _mm512_add_epi32(bits, _mm512_add_epi32(_mm512_set1_epi32(0x7FFF), lsb));
+    return _mm512_and_si512(rounded, _mm512_set1_epi32(std::int32_t(0xFFFF0000)));
+}
+
+inline __mmask16 lanes(Eigen::Index count)
+{
+    return count >= kTileSize ? __mmask16(0xFFFF) : count <= 0 ? __mmask16(0) : __mmask16((1u << count) - 1);
+}
+
+// Words (first[i], second[i]) for 16 rows i, of which count are valid; the rest and a missing second are zero
+__attribute__((target("avx512f"))) inline __m512i column_pair_words(const float *first, const float *second,
+                                                                    Eigen::Index count)
+{
+    const __m512i low = _mm512_srli_epi32(round_to_bfloat16(_mm512_maskz_loadu_ps(lanes(count), first)), 16);
+    if (!second)
+    {
+        return low;
+    }
+    return _mm512_or_si512(low, round_to_bfloat16(_mm512_maskz_loadu_ps(lanes(count), second)));
+}
+
+// Words (column[2p], column[2p + 1]) for 16 pairs p, of which count values are valid and the rest zero
+__attribute__((target("avx512f"))) inline __m512i row_pair_words(const float *column, Eigen::Index count)
+{
+    const __m512i low = _mm512_srli_epi32(round_to_bfloat16(_mm512_maskz_loadu_ps(lanes(count), column)), 16);
+    const __m512i high =
+        _mm512_srli_epi32(round_to_bfloat16(_mm512_maskz_loadu_ps(lanes(count - kTileSize), column + kTileSize)), 16);
+    return _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi32_epi16(low)), _mm512_cvtepi32_epi16(high), 1);
+}
+
+// In-register transpose of a 16 x 16 block of words, rows[i] lane j becomes rows[j] lane i
+__attribute__((target("avx512f"))) inline void transpose(__m512i rows[16])
+{
+    __m512i t[16];
+    for (int i = 0; i < 16; i += 2)
+    {
+        t[i] = _mm512_unpacklo_epi32(rows[i], rows[i + 1]);
+        t[i + 1] = _mm512_unpackhi_epi32(rows[i], rows[i + 1]);
+    }
+    for (int i = 0; i < 16; i += 4)
+    {
+        rows[i] = _mm512_unpacklo_epi64(t[i], t[i + 2]);
+        rows[i + 1] = _mm512_unpackhi_epi64(t[i], t[i + 2]);
+        rows[i + 2] = _mm512_unpacklo_epi64(t[i + 1], t[i + 3]);
+        rows[i + 3] = _mm512_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (int i = 0; i < 16; i += 8)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            t[i + j] = _mm512_shuffle_i32x4(rows[i + j], rows[i + j + 4], 0x88);
+            t[i + j + 4] = _mm512_shuffle_i32x4(rows[i + j], rows[i + j + 4], 0xDD);
+        }
+    }
+    for (int j = 0; j < 8; ++j)
+    {
+        rows[j] = _mm512_shuffle_i32x4(t[j], t[j + 8], 0x88);
+        rows[j + 8] = _mm512_shuffle_i32x4(t[j], t[j + 8], 0xDD);
+    }
+}
+#endif
+
+inline std::uint32_t column_pair_word(const float *m, Eigen::Index ld, Eigen::Index rows, Eigen::Index cols,
+                                      Eigen::Index i, Eigen::Index q)
+{
+    if (i >= rows || 2 * q >= cols)
+    {
+        return 0;
+    }
+    const std::uint32_t low = bf16::round_to_bfloat16(m[2 * q * ld + i]) >> 16;
+    return 2 * q + 1 < cols ? low | bf16::round_to_bfloat16(m[(2 * q + 1) * ld + i]) : low;
+}
+
+inline std::uint32_t row_pair_word(const float *m, Eigen::Index ld, Eigen::Index rows, Eigen::Index cols,
+                                   Eigen::Index p, Eigen::Index j)
+{
+    if (2 * p >= rows || j >= cols)
+    {
+        return 0;
+    }
+    const std::uint32_t low = bf16::round_to_bfloat16(m[j * ld + 2 * p]) >> 16;
+    return 2 * p + 1 < rows ? low | bf16::round_to_bfloat16(m[j * ld + 2 * p + 1]) : low;
+}
+
+#if defined(X86_KERNELS)
+__attribute__((target("avx512f"))) inline void pack_column_pairs_avx512(const float *m, Eigen::Index ld,
+                                                                         Eigen::Index rows, Eigen::Index cols,
+                                                                         PairTensor &out)
+{
+    for (Eigen::Index q = 0; q < padded(pairs(cols)); ++q)
+    {
+        std::uint32_t *column = out.col(q).data();
+        const float *first = m + 2 * q * ld;
+        const float *second = 2 * q + 1 < cols ? first + ld : nullptr;
+        for (Eigen::Index i = 0; i < padded(rows); i += kTileSize)
+        {
+            _mm512_storeu_si512(column + i, 2 * q < cols ? column_pair_words(first + i, second ? second + i : nullptr,
+                                                                             rows - i)
+                                                         : _mm512_setzero_si512());
+        }
+    }
+}
+
+__attribute__((target("avx512f"))) inline void pack_column_pairs_transposed_avx512(const float *m, Eigen::Index ld,
+                                                                                    Eigen::Index rows,
+                                                                                    Eigen::Index cols,
+                                                                                    PairTensor &out)
+{
+    for (Eigen::Index i0 = 0; i0 < padded(rows); i0 += kTileSize)
+    {
+        for (Eigen::Index q0 = 0; q0 < padded(pairs(cols)); q0 += kTileSize)
+        {
+            __m512i block[kTileSize];
+            for (Eigen::Index t = 0; t < kTileSize; ++t)
+            {
+                const Eigen::Index q = q0 + t;
+                const float *first = m + 2 * q * ld + i0;
+                block[t] = 2 * q < cols ? column_pair_words(first, 2 * q + 1 < cols ? first + ld : nullptr, rows - i0)
+                                        : _mm512_setzero_si512();
+            }
+            transpose(block);
+            for (Eigen::Index s = 0; s < kTileSize; ++s)
+            {
+                _mm512_storeu_si512(out.col(i0 + s).data() + q0, block[s]);
+            }
+        }
+    }
+}
+
+__attribute__((target("avx512f"))) inline void pack_row_pairs_avx512(const float *m, Eigen::Index ld,
+                                                                      Eigen::Index rows, Eigen::Index cols,
+                                                                      PairTensor &out)
+{
+    for (Eigen::Index j = 0; j < padded(cols); ++j)
+    {
+        std::uint32_t *column = out.col(j).data();
+        for (Eigen::Index p = 0; p < padded(pairs(rows)); p += kTileSize)
+        {
+            _mm512_storeu_si512(column + p, j < cols ? row_pair_words(m + j * ld + 2 * p, rows - 2 * p)
+                                                     : _mm512_setzero_si512());
+        }
+    }
+}
+
+__attribute__((target("avx512f"))) inline void pack_row_pairs_transposed_avx512(const float *m, Eigen::Index ld,
+                                                                                 Eigen::Index rows, Eigen::Index cols,
+                                                                                 PairTensor &out)
+{
+    for (Eigen::Index p0 = 0; p0 < padded(pairs(rows)); p0 += kTileSize)
+    {
+        for (Eigen::Index j0 = 0; j0 < padded(cols); j0 += kTileSize)
+        {
+            __m512i block[kTileSize];
+            for (Eigen::Index t = 0; t < kTileSize; ++t)
+            {
+                block[t] = j0 + t < cols ? row_pair_words(m + (j0 + t) * ld + 2 * p0, rows - 2 * p0)
+                                         : _mm512_setzero_si512();
+            }
+            transpose(block);
+            for (Eigen::Index s = 0; s < kTileSize; ++s)
+            {
+                _mm512_storeu_si512(out.col(p0 + s).data() + j0, block[s]);
+            }
+        }
+    }
+}
+#endif
+
+} // namespace detail
+
+/**
+ * @brief Vector-major pairs along the columns of the rows x cols float matrix m: out(i, q) = (m(i, 2q), m(i, 2q + 1))
+ * @param m Column-major
+ * @param ld Leading dimension of m
+ * @param rows
+ * @param cols
+ * @param out At least padded(rows) x padded(pairs(cols)); that part is overwritten
+ */
+inline void pack_column_pairs(const float *m, Eigen::Index ld, Eigen::Index rows, Eigen::Index cols, PairTensor &out)
+{
+    eigen_assert(out.rows() >= padded(rows) && out.cols() >= padded(pairs(cols)));
+#if defined(X86_KERNELS)
+    if (avx512_available())
+    {
+        detail::pack_column_pairs_avx512(m, ld, rows, cols, out);
+        return;
+    }
+#endif
+    for (Eigen::Index q = 0; q < padded(pairs(cols)); ++q)
+    {
+        std::uint32_t *column = out.col(q).data();
+        for (Eigen::Index i = 0; i < padded(rows); ++i)
+        {
+            column[i] = detail::column_pair_word(m, ld, rows, cols, i, q);
+        }
+    }
+}
+
+/**
+ * @brief Pair-major pairs along the columns of m: out(q, i) = (m(i, 2q), m(i, 2q + 1))
+ * @param m Column-major
+ * @param ld Leading dimension of m
+ * @param rows
+ * @param cols
+ * @param out At least padded(pairs(cols)) x padded(rows); that part is overwritten
+ */
+inline void pack_column_pairs_transposed(const float *m, Eigen::Index ld, Eigen::Index rows, Eigen::Index cols,
+                                         PairTensor &out)
+{
+    eigen_assert(out.rows() >= padded(pairs(cols)) && out.cols() >= padded(rows));
+#if defined(X86_KERNELS)
+    if (avx512_available())
+    {
+        detail::pack_column_pairs_transposed_avx512(m, ld, rows, cols, out);
+        return;
+    }
+#endif
+    for (Eigen::Index i = 0; i < padded(rows); ++i)
+    {
+        for (Eigen::Index q = 0; q < padded(pairs(cols)); ++q)
+        {
+            out(q, i) = detail::column_pair_word(m, ld, rows, cols, i, q);
+        }
+    }
+}
+
+/**
+ * @brief Pair-major pairs along the rows of m: out(p, j) = (m(2p, j), m(2p + 1, j)), i.e. every column of m in
+ * @brief bfloat16 as it is
+ * @param m Column-major
+ * @param ld Leading dimension of m
+ * @param rows
+ * @param cols
+ * @param out At least padded(pairs(rows)) x padded(cols); that part is overwritten
+ */
+inline void pack_row_pairs(const float *m, Eigen::Index ld, Eigen::Index rows, Eigen::Index cols, PairTensor &out)
+{
+    eigen_assert(out.rows() >= padded(pairs(rows)) && out.cols() >= padded(cols));
+#if defined(X86_KERNELS)
+    if (avx512_available())
+    {
+        detail::pack_row_pairs_avx512(m, ld, rows, cols, out);
+        return;
+    }
+#endif
+    for (Eigen::Index j = 0; j < padded(cols); ++j)
+    {
+        std::uint32_t *column = out.col(j).data();
+        for (Eigen::Index p = 0; p < padded(pairs(rows)); ++p)
+        {
+            column[p] = detail::row_pair_word(m, ld, rows, cols, p, j);
+        }
+    }
+}
+
+/**
+ * @brief Vector-major pairs along the rows of m: out(j, p) = (m(2p, j), m(2p + 1, j))
+ * @param m Column-major
+ * @param ld Leading dimension of m
+ * @param rows
+ * @param cols
+ * @param out At least padded(cols) x padded(pairs(rows)); that part is overwritten
+ */
+inline void pack_row_pairs_transposed(const float *m, Eigen::Index ld, Eigen::Index rows, Eigen::Index cols,
+                                      PairTensor &out)
+{
+    eigen_assert(out.rows() >= padded(cols) && out.cols() >= padded(pairs(rows)));
+#if defined(X86_KERNELS)
+    if (avx512_available())
+    {
+        detail::pack_row_pairs_transposed_avx512(m, ld, rows, cols, out);
+        return;
+    }
+#endif
+    for (Eigen::Index p = 0; p < padded(pairs(rows)); ++p)
+    {
+        for (Eigen::Index j = 0; j < padded(cols); ++j)
+        {
+            out(j, p) = detail::row_pair_word(m, ld, rows, cols, p, j);
+        }
+    }
+}
+
+namespace detail
+{
+
+#if defined(MIXED_PRECISION_AMX)
+struct alignas(64) TileConfig
+{
+    std::uint8_t palette;
+    std::uint8_t start_row;
+    std::uint8_t reserved[14];
+    std::uint16_t bytes_per_row[16];
+    std::uint8_t rows[16];
+};
+
+/**
+ * @brief gemm() on AMX tiles: every step multiplies two 16 x 16-pair tiles of a with two 16-pair x 16 tiles of b into
+ * @brief a 32 x 32 block of fp32 accumulator tiles. Blocks at the edge of c go through a scratch tile.
+ */
+__attribute__((target("amx-tile,amx-bf16"))) inline void gemm_amx(const PairTensor &a, const PairTensor &b,
+                                                                   Eigen::Index depth, Eigen::Index rows,
+                                                                   Eigen::Index cols, float *c, Eigen::Index ldc)
+{
+    TileConfig config{};
+    config.palette = 1;
+    for (int tile = 0; tile < 8; ++tile)
+    {
+        config.bytes_per_row[tile] = kTileSize * sizeof(std::uint32_t);
+        config.rows[tile] = kTileSize;
+    }
+    const Eigen::Index a_stride = a.rows() * sizeof(std::uint32_t);
+    const Eigen::Index b_stride = b.rows() * sizeof(std::uint32_t);
+    const Eigen::Index row_tiles = padded(rows) / kTileSize;
+    const Eigen::Index col_tiles = padded(cols) / kTileSize;
+
+#pragma omp parallel
+    {
+        _tile_loadconfig(&config);
+        alignas(64) float edge[kTileSize * kTileSize];
+        const auto store = [&](Eigen::Index r0, Eigen::Index v0, auto store_tile) {
+            if (r0 + kTileSize <= rows && v0 + kTileSize <= cols)
+            {
+                store_tile(c + r0 * ldc + v0, ldc * Eigen::Index(sizeof(float)));
+                return;
+            }
+            store_tile(edge, kTileSize * Eigen::Index(sizeof(float)));
+            for (Eigen::Index r = r0; r < std::min(r0 + kTileSize, rows); ++r)
+            {
+                std::copy_n(edge + (r - r0) * kTileSize, std::min(kTileSize, cols - v0), c + r * ldc + v0);
+            }
+        };
+
+#pragma omp for collapse(2) schedule(static)
+        for (Eigen::Index col_tile = 0; col_tile < col_tiles; col_tile += 2)
+        {
+            for (Eigen::Index row_tile = 0; row_tile < row_tiles; row_tile += 2)
+            {
+                const Eigen::Index r0 = row_tile * kTileSize;
+                const Eigen::Index v0 = col_tile * kTileSize;
+                const bool second_row = row_tile + 1 < row_tiles;
+                const bool second_col = col_tile + 1 < col_tiles;
+                _tile_zero(0);
+                _tile_zero(1);
+                _tile_zero(2);
+                _tile_zero(3);
+                for (Eigen::Index q0 = 0; q0 < depth; q0 += kTileSize)
+                {
+                    _tile_loadd(4, a.data() + r0 * a.rows() + q0, a_stride);
+                    _tile_loadd(6, b.data() + q0 * b.rows() + v0, b_stride);
+                    _tile_dpbf16ps(0, 4, 6);
+                    if (second_col)
+                    {
+                        _tile_loadd(7, b.data() + q0 * b.rows() + v0 + kTileSize, b_stride);
+                        _tile_dpbf16ps(1, 4, 7);
+                    }
+                    if (second_row)
+                    {
+                        _tile_loadd(5, a.data() + (r0 + kTileSize) * a.rows() + q0, a_stride);
+                        _tile_dpbf16ps(2, 5, 6);
+                        if (second_col)
+                        {
+                            _tile_dpbf16ps(3, 5, 7);
+                        }
+                    }
+                }
+                store(r0, v0, [](float *p, Eigen::Index stride) { _tile_stored(0, p, stride); });
+                if (second_col)
+                {
+                    store(r0, v0 + kTileSize, [](float *p, Eigen::Index stride) { _tile_stored(1, p, stride); });
+                }
+                if (second_row)
+                {
+                    store(r0 + kTileSize, v0, [](float *p, Eigen::Index stride) { _tile_stored(2, p, stride); });
+                    if (second_col)
+                    {
+                        store(r0 + kTileSize, v0 + kTileSize,
+                              [](float *p, Eigen::Index stride) { _tile_stored(3, p, stride); });
+                    }
+                }
+            }
+        }
+        _tile_release();
+    }
+}
+#endif
+
+#if defined(X86_KERNELS)
+/**
+ * @brief acc + a.low * b.low + a.high * b.high per 32-bit lane: one vdpbf16ps with AVX512-BF16, otherwise the
+ * @brief bfloat16 halves are widened to floats (a shift or a mask) and multiplied with two FMAs. The vdpbf16ps is
+ * @brief inline assembly so that the kernels are compiled for AVX-512F alone and never contain other AVX512-BF16
+ * @brief instructions the compiler might choose on its own.
+ */
+template <bool Bf16>
+__attribute__((target("avx512f"))) inline __m512 dot_pairs(__m512 acc, __m512i a, __m512i b)
+{
+    if constexpr (Bf16)
+    {
+        asm("vdpbf16ps %2, %1, %0" : "+v"(acc) : "v"(a), "v"(b));
+        return acc;
+    }
+    const __m512i upper = _mm512_set1_epi32(std::int32_t(0xFFFF0000));
+    acc = _mm512_fmadd_ps(_mm512_castsi512_ps(_mm512_slli_epi32(a, 16)),
+                          _mm512_castsi512_ps(_mm512_slli_epi32(b, 16)), acc);
+    return _mm512_fmadd_ps(_mm512_castsi512_ps(_mm512_and_si512(a, upper)),
+                           _mm512_castsi512_ps(_mm512_and_si512(b, upper)), acc);
+}
+
+/**
+ * @brief R x V block of the AVX-512 kernel: R broadcast pairs of a times V vectors of b over depth pairs, accumulated
+ * @brief in registers and added to c if accumulate is set
+ */
+template <bool Bf16, int R, int V>
+__attribute__((target("avx512f"))) inline void gemm_block(const std::uint32_t *a, Eigen::Index lda,
+                                                          const std::uint32_t *b, Eigen::Index ldb, Eigen::Index depth,
+                                                          float *c, Eigen::Index ldc, __mmask16 last_vector,
+                                                          bool accumulate)
+{
+    __m512 acc[R][V];
+    for (int r = 0; r < R; ++r)
+    {
+        for (int v = 0; v < V; ++v)
+        {
+            const __mmask16 valid = v == V - 1 ? last_vector : __mmask16(0xFFFF);
+            acc[r][v] = accumulate ? _mm512_maskz_loadu_ps(valid, c + r * ldc + v * kTileSize) : _mm512_setzero_ps();
+        }
+    }
+    for (Eigen::Index q = 0; q < depth; ++q)
+    {
+        __m512i b_pairs[V];
+        for (int v = 0; v < V; ++v)
+        {
+            b_pairs[v] = _mm512_loadu_si512(b + q * ldb + v * kTileSize);
+        }
+        for (int r = 0; r < R; ++r)
+        {
+            const __m512i a_pair = _mm512_set1_epi32(std::int32_t(a[r * lda + q]));
+            for (int v = 0; v < V; ++v)
+            {
+                acc[r][v] = dot_pairs<Bf16>(acc[r][v], a_pair, b_pairs[v]);
+            }
+        }
+    }
+    for (int r = 0; r < R; ++r)
+    {
+        for (int v = 0; v < V - 1; ++v)
+        {
+            _mm512_storeu_ps(c + r * ldc + v * kTileSize, acc[r][v]);
+        }
+        _mm512_mask_storeu_ps(c + r * ldc + (V - 1) * kTileSize, last_vector, acc[r][V - 1]);
+    }
+}
+
+template <bool Bf16, int V>
+__attribute__((target("avx512f"))) inline void gemm_block(int rows, const std::uint32_t *a, Eigen::Index lda,
+                                                          const std::uint32_t *b, Eigen::Index ldb, Eigen::Index depth,
+                                                          float *c, Eigen::Index ldc, __mmask16 last_vector,
+                                                          bool accumulate)
+{
+    static_assert(kBlockRows == 6);
+    switch (rows)
+    {
+    case 1: gemm_block<Bf16, 1, V>(a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    case 2: gemm_block<Bf16, 2, V>(a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    case 3: gemm_block<Bf16, 3, V>(a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    case 4: gemm_block<Bf16, 4, V>(a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    case 5: gemm_block<Bf16, 5, V>(a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    default: gemm_block<Bf16, 6, V>(a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    }
+}
+
+// Block of up to kBlockRows x kBlockVectors, the last vector masked to the columns of c
+template <bool Bf16>
+__attribute__((target("avx512f"))) inline void gemm_block(int rows, int vectors, const std::uint32_t *a,
+                                                          Eigen::Index lda, const std::uint32_t *b, Eigen::Index ldb,
+                                                          Eigen::Index depth, float *c, Eigen::Index ldc,
+                                                          __mmask16 last_vector, bool accumulate)
+{
+    static_assert(kBlockVectors == 4);
+    switch (vectors)
+    {
+    case 1: gemm_block<Bf16, 1>(rows, a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    case 2: gemm_block<Bf16, 2>(rows, a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    case 3: gemm_block<Bf16, 3>(rows, a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    default: gemm_block<Bf16, 4>(rows, a, lda, b, ldb, depth, c, ldc, last_vector, accumulate); break;
+    }
+}
+
+/**
+ * @brief gemm() with the AVX-512 kernel, in blocks of kBlockRows pairs of a times kBlockVectors vectors of b
+ */
+template <bool Bf16>
+__attribute__((target("avx512f"))) inline void gemm_avx512(const PairTensor &a, const PairTensor &b,
+                                                           Eigen::Index depth, Eigen::Index rows, Eigen::Index cols,
+                                                           float *c, Eigen::Index ldc)
+{
+    constexpr Eigen::Index block_cols = kBlockVectors * kTileSize;
+    const Eigen::Index row_blocks = (rows + kBlockRows - 1) / kBlockRows;
+    const Eigen::Index col_blocks = (cols + block_cols - 1) / block_cols;
+    for (Eigen::Index q0 = 0; q0 < depth; q0 += kDepthBlock)
+    {
+        const Eigen::Index block_depth = std::min(kDepthBlock, depth - q0);
+        // All row blocks of a column block in turn, which share its panel of b
+#pragma omp parallel for collapse(2) schedule(static)
+        for (Eigen::Index col_block = 0; col_block < col_blocks; ++col_block)
+        {
+            for (Eigen::Index row_block = 0; row_block < row_blocks; ++row_block)
+            {
+                const Eigen::Index v0 = col_block * block_cols;
+                const Eigen::Index r0 = row_block * kBlockRows;
+                const Eigen::Index block_width = std::min(block_cols, cols - v0);
+                const int vectors = int((block_width + kTileSize - 1) / kTileSize);
+                gemm_block<Bf16>(int(std::min<Eigen::Index>(kBlockRows, rows - r0)), vectors,
+                                 a.data() + r0 * a.rows() + q0, a.rows(), b.data() + q0 * b.rows() + v0, b.rows(),
+                                 block_depth, c + r0 * ldc + v0, ldc, lanes(block_width - (vectors - 1) * kTileSize),
+                                 q0 > 0);
+            }
+        }
+    }
+}
+#endif
+
+} // namespace detail
+
+/**
+ * @brief c[r * ldc + v] = sum over q < depth of the dot product of the pairs a(q, r) and b(v, q), accumulated in fp32,
+ * @brief for r < rows and v < cols. c is contiguous along v, e.g. a column-major matrix with r as column index.
+ * @param a Pair-major, at least depth x padded(rows)
+ * @param b Vector-major, at least padded(cols) x depth
+ * @param depth Number of pairs, a multiple of kTileSize
+ * @param rows
+ * @param cols
+ * @param c
+ * @param ldc
+ */
+inline void gemm(const PairTensor &a, const PairTensor &b, Eigen::Index depth, Eigen::Index rows, Eigen::Index cols,
+                 float *c, Eigen::Index ldc)
+{
+    eigen_assert(depth % kTileSize == 0 && a.rows() >= depth && a.cols() >= padded(rows) &&
+                 b.rows() >= padded(cols) && b.cols() >= depth);
+#if defined(MIXED_PRECISION_AMX)
+    if (amx_available())
+    {
+        detail::gemm_amx(a, b, depth, rows, cols, c, ldc);
+        return;
+    }
+#endif
+#if defined(X86_KERNELS)
+    if (avx512_bf16_available())
+    {
+        detail::gemm_avx512<true>(a, b, depth, rows, cols, c, ldc);
+        return;
+    }
+    if (avx512_available())
+    {
+        detail::gemm_avx512<false>(a, b, depth, rows, cols, c, ldc);
+        return;
+    }
+#endif
+    const auto widen = [](std::uint32_t bits) { return std::bit_cast<float>(bits << 16); };
+    for (Eigen::Index r = 0; r < rows; ++r)
+    {
+        for (Eigen::Index v = 0; v < cols; ++v)
+        {
+            float sum = 0.0f;
+            for (Eigen::Index q = 0; q < depth; ++q)
+            {
+                const std::uint32_t x = a(q, r);
+                const std::uint32_t y = b(v, q);
+                sum += widen(x & 0xFFFF) * widen(y & 0xFFFF) + widen(x >> 16) * widen(y >> 16);
+            }
+            c[r * ldc + v] = sum;
+        }
+    }
+}
+
+} // namespace bf16
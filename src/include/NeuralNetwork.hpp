@@ -1,78 +1,292 @@
 #pragma once
 
 #include "BaseLayer.hpp"
+#include "Conv2D.hpp"
 #include "FullyConnected.hpp"
 #include "Initializers.hpp"
 #include "Loss.hpp"
+#include "MaxPool2D.hpp"
 #include "Optimizers.hpp"
-#include "ReLU.hpp"
+#include "ParameterArena.hpp"
+#include "Quantization.hpp"
+#include "Schedulers.hpp"
+#include "Sequential.hpp"
 #include "SoftMax.hpp"
+#include "SoftMaxCrossEntropyLoss.hpp"
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <omp.h>
+#include <span>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+namespace detail {
+
+template <std::size_t, typename Layer> using Repeat = Layer;
+
+// BasicSequential<First, Middle, ..., Middle, Last> with one Middle per index
+template <typename First, typename Middle, typename Last, typename Indices> struct RepeatedSequential;
+
+template <typename First, typename Middle, typename Last, std::size_t... I>
+struct RepeatedSequential<First, Middle, Last, std::index_sequence<I...>> {
+    using type = BasicSequential<First, Repeat<I, Middle>..., Last>;
+};
+
+} // namespace detail
+
 /**
  * @author Hamiz Ali
  * @since 24.01.2025
  *
  * @brief Neural Network class
+ * @brief The layer sizes are runtime values by default (Eigen::Dynamic); fixing them at compile time selects the
+ * @brief fixed-shape fully connected layers. Scalar is the element type of all tensors, from the dataset to the
+ * @brief optimizer state (double or float). HiddenLayers is the depth of the stack of hidden fully connected layers;
+ * @brief HiddenSize can only fix the width of a single one. Convolutional replaces the hidden fully connected layer by
+ * @brief a 5x5 convolution into hidden_size feature maps and 2x2 max pooling, for square single-channel input images.
  */
-class NeuralNetwork {
+template <int InputSize = Eigen::Dynamic, int HiddenSize = Eigen::Dynamic, int OutputSize = Eigen::Dynamic,
+          typename Scalar = double, bool Convolutional = false, int HiddenLayers = 1>
+class BasicNeuralNetwork {
+    static_assert(HiddenLayers >= 1, "the network needs a hidden layer");
+    static_assert(HiddenLayers == 1 || HiddenSize == Eigen::Dynamic, "deeper networks have runtime widths");
+    static_assert(HiddenLayers == 1 || !Convolutional, "the convolutional network has a single hidden layer");
+
+  public:
+    using Tensor = BasicTensor<Scalar>;
+    using SparseTensor = BasicSparseTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+    using RowMajorTensor = BasicRowMajorTensor<Scalar>;
+    using ConstRowMajorTensorRef = BasicConstRowMajorTensorRef<Scalar>;
+    using Optimizer = BasicOptimizer<Scalar>;
+    using Initializer = BasicInitializer<Scalar>;
+    // Hidden layers with the ReLU activation fused into them, followed by the output layer producing the logits
+    using HiddenLayer = BasicFullyConnected<InputSize, HiddenSize, true, Scalar>;
+    using DeepHiddenLayer = BasicFullyConnected<Eigen::Dynamic, Eigen::Dynamic, true, Scalar>;
+    using OutputLayer = BasicFullyConnected<HiddenSize, OutputSize, false, Scalar>;
+    // Convolution with the ReLU fused into it and max pooling, followed by the output layer on the pooled maps
+    using ConvolutionLayer = BasicConv2D<true, Scalar>;
+    using PoolingLayer = BasicMaxPool2D<Scalar>;
+    using PooledOutputLayer = BasicFullyConnected<Eigen::Dynamic, OutputSize, false, Scalar>;
+    using Layers = std::conditional_t<
+        Convolutional, BasicSequential<ConvolutionLayer, PoolingLayer, PooledOutputLayer>,
+        typename detail::RepeatedSequential<HiddenLayer, DeepHiddenLayer, OutputLayer,
+                                            std::make_index_sequence<HiddenLayers - 1>>::type>;
+
+    static constexpr Eigen::Index kernel_size = 5;
+    static constexpr Eigen::Index pool_size = 2;
+
   private:
-    FullyConnected *fc1;
-    ReLU *relu;
-    FullyConnected *fc2;
-    SoftMax *softmax;
-    CrossEntropyLoss *loss;
-    // Optimizer *optimizer;
-    Optimizer *optimizer1;
-    Optimizer *optimizer2;
+    Optimizer *optimizer;
+    // Learning rate of every step of fit(), if set; not owned
+    const LearningRateSchedule *schedule = nullptr;
     Initializer *weights_initializer;
     Initializer *bias_initializer;
 
+    Layers layers;
+    // Weights and biases of all layers, their gradients and the optimizer state, which the layers view
+    BasicParameterArena<Scalar> parameters;
+    // Element ranges of the parameters that a step after a sparse batch updates
+    std::vector<ParameterRange> sparse_ranges;
+    BasicSoftMax<Scalar> softmax;
+    BasicCrossEntropyLoss<Scalar> loss;
+    // Replaces softmax and loss in training if fused_softmax_loss is set
+    BasicSoftMaxCrossEntropyLoss<Scalar> softmax_loss;
+
     unsigned int input_size;
-    unsigned int hidden_size;
+    std::vector<unsigned int> hidden_sizes;
     unsigned int output_size;
-    double learning_rate;
+    bool fused_softmax_loss;
+
+    // Activations and errors of the head in the buffer based training step, one row per sample of the largest
+    // batch; those between the layers are workspaces of the pipeline
+    Tensor logits;
+    Tensor probabilities;
+    Tensor error_probabilities;
+    Tensor error_logits;
+    // Empty: the first layer has no predecessor to propagate its error to
+    Tensor error_input;
 
   public:
     /**
      * @author Hamiz Ali, Lam Tran
      * @since 29.01.2025
      *
-     * @brief Construct a new Neural Network object
+     * @brief Construct a new Neural Network object trained with ADAM
      *
      * @param input_size
      * @param hidden_size
      * @param output_size
      * @param learning_rate
+     * @param max_batch_size Largest training batch, sizes the workspaces of the allocation-free training step
+     * @param fused_softmax_loss Use the fused SoftMaxCrossEntropyLoss head instead of SoftMax + CrossEntropyLoss
+     * @param mixed_precision Train all fully connected layers with bfloat16 products (float networks only)
+     */
+    BasicNeuralNetwork(unsigned int input_size, unsigned int hidden_size, unsigned int output_size,
+                       double learning_rate, unsigned int max_batch_size = 1, bool fused_softmax_loss = false,
+                       bool mixed_precision = false)
+        : BasicNeuralNetwork(input_size, hidden_size, output_size, BasicADAM<Scalar>(learning_rate, 0.9, 0.999, 1e-8),
+                             max_batch_size, fused_softmax_loss, mixed_precision) {}
+
+    /**
+     * @brief Construct a new Neural Network object trained with a clone of the given optimizer, which steps the
+     * @brief parameters of all layers in one pass over their arena after every backward pass
+     *
+     * @param input_size
+     * @param hidden_size Width of every hidden layer
+     * @param output_size
+     * @param optimizer Hyperparameters of the optimizer, e.g. BasicSGD with momentum
+     * @param max_batch_size Largest training batch, sizes the workspaces of the allocation-free training step
+     * @param fused_softmax_loss Use the fused SoftMaxCrossEntropyLoss head instead of SoftMax + CrossEntropyLoss
+     * @param mixed_precision Train all fully connected layers with bfloat16 products (float networks only)
+     */
+    BasicNeuralNetwork(unsigned int input_size, unsigned int hidden_size, unsigned int output_size,
+                       const Optimizer &optimizer, unsigned int max_batch_size = 1, bool fused_softmax_loss = false,
+                       bool mixed_precision = false)
+        : BasicNeuralNetwork(input_size, std::vector<unsigned int>(HiddenLayers, hidden_size), output_size, optimizer,
+                             max_batch_size, fused_softmax_loss, mixed_precision) {}
+
+    /**
+     * @brief Construct a new Neural Network object with one width per hidden layer
+     *
+     * @param input_size
+     * @param hidden_sizes HiddenLayers widths, in the order of the forward pass
+     * @param output_size
+     * @param optimizer Hyperparameters of the optimizer, e.g. BasicSGD with momentum
+     * @param max_batch_size Largest training batch, sizes the workspaces of the allocation-free training step
+     * @param fused_softmax_loss Use the fused SoftMaxCrossEntropyLoss head instead of SoftMax + CrossEntropyLoss
+     * @param mixed_precision Train all fully connected layers with bfloat16 products (float networks only)
+     */
+    BasicNeuralNetwork(unsigned int input_size, const std::vector<unsigned int> &hidden_sizes,
+                       unsigned int output_size, const Optimizer &optimizer, unsigned int max_batch_size = 1,
+                       bool fused_softmax_loss = false, bool mixed_precision = false)
+        // Initialize optimizer and initializers (seed 123), then the layers
+        : optimizer(optimizer.clone().release()),
+          weights_initializer(new BasicXavier<Scalar>(123)), bias_initializer(new BasicXavier<Scalar>(123)),
+          layers(make_layers(input_size, hidden_sizes, output_size)),
+          input_size(input_size), hidden_sizes(hidden_sizes), output_size(output_size),
+          fused_softmax_loss(fused_softmax_loss) {
+        // Initialize weights and biases for layers, in the order of the forward pass
+        layers.for_each([&](auto &layer) {
+            if constexpr (requires { layer.initialize(weights_initializer, bias_initializer); }) {
+                layer.initialize(weights_initializer, bias_initializer);
+            }
+        });
+
+        // Move the parameters of the layers into the arena of the network
+        layers.for_each([&](auto &layer) {
+            if constexpr (requires { layer.add_parameters(parameters); }) {
+                layer.add_parameters(parameters);
+            }
+        });
+        parameters.allocate(this->optimizer->state_planes());
+        layers.for_each([&](auto &layer) {
+            if constexpr (requires { layer.bind_parameters(parameters); }) {
+                layer.bind_parameters(parameters);
+            }
+        });
+
+        if constexpr (std::is_same_v<Scalar, float>) {
+            // Only the fully connected layers have a mixed precision path
+            layers.for_each([&](auto &layer) {
+                if constexpr (requires { layer.set_mixed_precision(mixed_precision); }) {
+                    layer.set_mixed_precision(mixed_precision);
+                }
+            });
+        } else {
+            eigen_assert(!mixed_precision && "mixed precision needs a float network");
+        }
+
+        reserve(max_batch_size);
+    }
+
+  private:
+    /**
+     * @brief The layers of the network: input -> hidden (ReLU) -> ... -> hidden (ReLU) -> output, or for a
+     * @brief convolutional network, images of sqrt(input_size) x sqrt(input_size) pixels -> hidden_size feature maps
+     * @brief (ReLU) -> max pooling -> output. The layers have no optimizer of their own; the network steps their
+     * @brief parameters.
+     *
+     * @return Layers
+     */
+    static Layers make_layers(unsigned int input_size, const std::vector<unsigned int> &hidden_sizes,
+                              unsigned int output_size) {
+        eigen_assert(hidden_sizes.size() == std::size_t(HiddenLayers));
+        if constexpr (Convolutional) {
+            const unsigned int hidden_size = hidden_sizes[0];
+            const Eigen::Index side = std::lround(std::sqrt(double(input_size)));
+            eigen_assert(side * side == Eigen::Index(input_size) && "the convolutional network takes square images");
+            ConvolutionLayer convolution(1, side, side, hidden_size, kernel_size, nullptr);
+            const Eigen::Index maps_side = side - kernel_size + 1;
+            PoolingLayer pooling(hidden_size, maps_side, maps_side, pool_size);
+            const Eigen::Index pooled = hidden_size * (maps_side / pool_size) * (maps_side / pool_size);
+            return Layers(input_size, std::move(convolution), std::move(pooling),
+                          PooledOutputLayer(pooled, output_size, nullptr));
+        } else {
+            return [&]<std::size_t... I>(std::index_sequence<I...>) {
+                return Layers(input_size, HiddenLayer(input_size, hidden_sizes[0], nullptr),
+                              DeepHiddenLayer(hidden_sizes[I], hidden_sizes[I + 1], nullptr)...,
+                              OutputLayer(hidden_sizes.back(), output_size, nullptr));
+            }(std::make_index_sequence<HiddenLayers - 1>());
+        }
+    }
+
+    /**
+     * @brief One optimizer step over the parameters of all layers, with the gradients of the last backward pass
      */
-    NeuralNetwork(unsigned int input_size, unsigned int hidden_size, unsigned int output_size, double learning_rate)
-        : input_size(input_size), hidden_size(hidden_size), output_size(output_size), learning_rate(learning_rate) {
-        // Initialize optimizer and initializers
-        int seed = 123;
-        // optimizer = new SGD(learning_rate);
-        optimizer1 = new ADAM(learning_rate, 0.9, 0.999, 1e-8);
-        // optimizer1 = new SGD(learning_rate);
-        optimizer2 = new ADAM(learning_rate, 0.9, 0.999, 1e-8);
-        // optimizer2 = new SGD(learning_rate);
-        weights_initializer = new Xavier(seed);
-        bias_initializer = new Xavier(seed);
-
-        // Initialize layers
-        fc1 = new FullyConnected(input_size, hidden_size, optimizer1);
-        relu = new ReLU();
-        fc2 = new FullyConnected(hidden_size, output_size, optimizer2);
-        softmax = new SoftMax();
-        loss = new CrossEntropyLoss();
-
-        // Initialize weights and biases for layers
-        // fc1->initialize(weights_initializer, weights_initializer);
-        fc1->initialize(weights_initializer, bias_initializer);
-        // fc2->initialize(weights_initializer, weights_initializer);
-        fc2->initialize(weights_initializer, bias_initializer);
+    void step() {
+        const typename Optimizer::Parameter all_parameters = parameters.parameter();
+        optimizer->step(typename Optimizer::ParamGroup(&all_parameters, 1));
+    }
+
+    /**
+     * @brief One optimizer step after the backward pass of a sparse batch: the weights of the first fully connected
+     * @brief layer are stepped only in the columns of the features that are non-zero in the batch, the other
+     * @brief parameters in full
+     */
+    void step_sparse() {
+        const auto &first = layers.template layer<0>();
+        if constexpr (requires { first.sparse_features(); }) {
+            const typename Optimizer::Parameter all_parameters =
+                parameters.parameter(first.weights_slot(), first.sparse_features(), sparse_ranges);
+            optimizer->step(typename Optimizer::ParamGroup(&all_parameters, 1));
+        } else {
+            step();
+        }
+    }
+
+  public:
+    /**
+     * @brief Set the learning rate of every training step of fit() from the schedule, whose steps are the batches
+     * @brief counted from the first epoch on; nullptr keeps the rate of the optimizer
+     *
+     * @param schedule Not owned, it has to outlive the training
+     */
+    void set_schedule(const LearningRateSchedule *schedule) {
+        this->schedule = schedule;
+    }
+
+    /**
+     * @brief Size the workspaces of the network and its layers for batches of up to max_batch_size samples
+     *
+     * @param max_batch_size
+     */
+    void reserve(Eigen::Index max_batch_size) {
+        if (max_batch_size <= logits.rows()) {
+            return;
+        }
+        logits.resize(max_batch_size, output_size);
+        probabilities.resize(max_batch_size, output_size);
+        error_probabilities.resize(max_batch_size, output_size);
+        error_logits.resize(max_batch_size, output_size);
+        layers.reserve(max_batch_size);
+        softmax.reserve(max_batch_size);
+        loss.reserve(max_batch_size);
+        softmax_loss.reserve(max_batch_size);
     }
 
     /**
@@ -80,15 +294,14 @@ class NeuralNetwork {
      * @since 24.01.2025
      *
      * @brief Forward pass through the neural network
+     * @brief for a dense (Tensor) or sparse (SparseTensor) input batch
      *
      * @param input_tensor
      * @return Tensor
      */
-    Tensor forward(const Tensor &input_tensor) {
-        Tensor output = fc1->forward(input_tensor);
-        output = relu->forward(output);
-        output = fc2->forward(output);
-        return softmax->forward(output);
+    template <typename Input> Tensor forward(const Input &input_tensor) {
+        Tensor output = layers.forward(input_tensor);
+        return fused_softmax_loss ? softmax_loss.forward(output) : softmax.forward(output);
     }
 
     /**
@@ -96,26 +309,99 @@ class NeuralNetwork {
      * @since 24.01.2025
      *
      * @brief Training function for the neural network with forward and backward pass and loss computation
+     * @brief for a sparse input batch
      *
      * @param input_tensor
      * @param label_tensor
      * @return double
      */
-    double train(const Tensor &input_tensor, const Tensor &label_tensor) {
+    double train(const SparseTensor &input_tensor, const Tensor &label_tensor) {
+        double loss_value;
+        Tensor error_tensor;
+        if (fused_softmax_loss) {
+            // Forward pass up to the logits
+            Tensor logits_tensor = layers.forward(input_tensor);
+            // Compute loss and the error tensor of the logits
+            Tensor predictions(logits_tensor.rows(), logits_tensor.cols());
+            loss_value = softmax_loss.computed_loss(logits_tensor, label_tensor, predictions);
+            error_tensor = softmax_loss.backward(label_tensor);
+        } else {
+            // Forward pass
+            Tensor predictions = forward(input_tensor);
+            // Compute loss
+            loss_value = loss.computed_loss(predictions, label_tensor);
+            // Backward pass
+            error_tensor = loss.backward(label_tensor);
+            error_tensor = softmax.backward(error_tensor);
+        }
+        layers.backward(error_tensor);
+        step_sparse();
+
+        return loss_value;
+    }
+
+    /**
+     * @brief Training step for a dense input batch that runs every layer on the preallocated workspaces.
+     * @brief It does not allocate, as the optimizer state lives in the parameter arena; builds with
+     * @brief EIGEN_RUNTIME_NO_MALLOC (make NO_MALLOC_CHECK=1) assert that. The batch is a row-major view, e.g. a row
+     * @brief block of the dataset, which the first layer reads in place.
+     *
+     * @param input_tensor
+     * @param label_tensor
+     * @return double
+     */
+    double train(const ConstRowMajorTensorRef &input_tensor, const ConstTensorRef &label_tensor) {
+        const Eigen::Index batch_size = input_tensor.rows();
+        reserve(batch_size);
+        MallocGuard no_malloc(false);
+
+        auto logits_batch = logits.topRows(batch_size);
+        auto probabilities_batch = probabilities.topRows(batch_size);
+        auto error_probabilities_batch = error_probabilities.topRows(batch_size);
+        auto error_logits_batch = error_logits.topRows(batch_size);
+
         // Forward pass
-        Tensor predictions = forward(input_tensor);
-        // Compute loss
-        double loss_value = loss->computed_loss(predictions, label_tensor);
-        // Backward pass
-        Tensor error_tensor = loss->backward(label_tensor);
-        error_tensor = softmax->backward(error_tensor);
-        error_tensor = fc2->backward(error_tensor);
-        error_tensor = relu->backward(error_tensor);
-        fc1->backward(error_tensor);
+        layers.forward(input_tensor, logits_batch);
+        double loss_value;
+        if (fused_softmax_loss) {
+            // Compute loss and the error tensor of the logits
+            loss_value = softmax_loss.computed_loss(logits_batch, label_tensor, probabilities_batch);
+            softmax_loss.backward(label_tensor, error_logits_batch);
+        } else {
+            softmax.forward(logits_batch, probabilities_batch);
+            // Compute loss
+            loss_value = loss.computed_loss(probabilities_batch, label_tensor);
+            // Backward pass
+            loss.backward(label_tensor, error_probabilities_batch);
+            softmax.backward(error_probabilities_batch, error_logits_batch);
+        }
+        layers.backward(error_logits_batch, error_input);
+        step();
 
         return loss_value;
     }
 
+    /**
+     * @brief Probabilities for a dense input batch, computed on the workspaces of the training step
+     *
+     * @param input_tensor Row-major view of the batch, e.g. a row block of the dataset
+     * @return ConstTensorRef View of the probabilities, valid until the next call to train() or predict()
+     */
+    ConstTensorRef predict(const ConstRowMajorTensorRef &input_tensor) {
+        const Eigen::Index batch_size = input_tensor.rows();
+        reserve(batch_size);
+
+        auto logits_batch = logits.topRows(batch_size);
+        auto probabilities_batch = probabilities.topRows(batch_size);
+        layers.forward(input_tensor, logits_batch);
+        if (fused_softmax_loss) {
+            softmax_loss.forward(logits_batch, probabilities_batch);
+        } else {
+            softmax.forward(logits_batch, probabilities_batch);
+        }
+        return probabilities_batch;
+    }
+
     /**
      * @author Hamiz Ali
      * @since 24.01.2025
@@ -128,7 +414,8 @@ class NeuralNetwork {
      * @param batch_size
      * @param log_file
      */
-    double evaluate(const Tensor &test_images, const Tensor &test_labels, unsigned int batch_size,
+    template <typename Images>
+    double evaluate(const Images &test_images, const Tensor &test_labels, unsigned int batch_size,
                     const std::string &log_file) {
         std::ofstream log_stream(log_file);
         unsigned int correct_count = 0;
@@ -137,22 +424,25 @@ class NeuralNetwork {
         {
             log_stream << "Current batch: " << batch_start / batch_size << std::endl;
 
-            Tensor batch_images = test_images.middleRows(
-                batch_start, std::min(batch_size, (unsigned int)test_images.rows() - batch_start));
-            Tensor batch_labels = test_labels.middleRows(
-                batch_start, std::min(batch_size, (unsigned int)test_labels.rows() - batch_start));
-            Tensor predictions = forward(batch_images);
-
-            for (int i = 0; i < predictions.rows(); i++) {
-                int predicted_label = 0, actual_label = 0;
-                predictions.row(i).maxCoeff(&predicted_label); // Get predicted class
-                batch_labels.row(i).maxCoeff(&actual_label);   // Get actual class
+            const unsigned int rows = std::min(batch_size, (unsigned int)test_images.rows() - batch_start);
+            auto log_batch = [&](const auto &predictions) {
+                for (int i = 0; i < predictions.rows(); i++) {
+                    int predicted_label = 0, actual_label = 0;
+                    predictions.row(i).maxCoeff(&predicted_label);             // Get predicted class
+                    test_labels.row(batch_start + i).maxCoeff(&actual_label); // Get actual class
 
-                log_stream << " - image " << (batch_start + i) << ": Prediction=" << predicted_label
-                           << ". Label=" << actual_label << std::endl;
+                    log_stream << " - image " << (batch_start + i) << ": Prediction=" << predicted_label
+                               << ". Label=" << actual_label << std::endl;
 
-                if (predicted_label == actual_label)
-                    correct_count++;
+                    if (predicted_label == actual_label)
+                        correct_count++;
+                }
+            };
+            if constexpr (std::is_same_v<Images, SparseTensor>) {
+                log_batch(forward(Images(test_images.middleRows(batch_start, rows))));
+            } else {
+                // Dense batches are row blocks of the dataset, predicted without a copy
+                log_batch(predict(test_images.middleRows(batch_start, rows)));
             }
         }
         log_stream.close();
@@ -170,17 +460,29 @@ class NeuralNetwork {
      * @param train_labels
      * @param num_epochs
      * @param batch_size
+     * @param first_epoch Number of epochs trained before, e.g. when training one epoch per call; with a learning
+     * rate schedule, the steps of the schedule continue from there
      */
-    void fit(const Tensor &train_images, const Tensor &train_labels, unsigned int num_epochs, unsigned int batch_size) {
-        for (unsigned int epoch = 0; epoch < num_epochs; ++epoch) {
+    template <typename Images>
+    void fit(const Images &train_images, const Tensor &train_labels, unsigned int num_epochs,
+             unsigned int batch_size, unsigned int first_epoch = 0) {
+        const long long steps_per_epoch = (train_images.rows() + batch_size - 1) / batch_size;
+        for (unsigned int epoch = first_epoch; epoch < first_epoch + num_epochs; ++epoch) {
             int batch_num = 1;
             double batch_loss = 0.0;
             for (int i = 0; i < train_images.rows(); i += batch_size) {
-                Tensor batch_images =
-                    train_images.middleRows(i, std::min(batch_size, (unsigned int)train_images.rows() - i));
-                Tensor batch_labels =
-                    train_labels.middleRows(i, std::min(batch_size, (unsigned int)train_labels.rows() - i));
-                batch_loss = (train(batch_images, batch_labels) / batch_images.rows());
+                const unsigned int rows = std::min(batch_size, (unsigned int)train_images.rows() - i);
+                if (schedule != nullptr) {
+                    optimizer->set_learning_rate(schedule->learning_rate(epoch * steps_per_epoch + batch_num - 1));
+                }
+                if constexpr (std::is_same_v<Images, SparseTensor>) {
+                    Images batch_images = train_images.middleRows(i, rows);
+                    Tensor batch_labels = train_labels.middleRows(i, rows);
+                    batch_loss = (train(batch_images, batch_labels) / rows);
+                } else {
+                    // Dense batches are contiguous row blocks of the row-major dataset, passed on without a copy
+                    batch_loss = (train(train_images.middleRows(i, rows), train_labels.middleRows(i, rows)) / rows);
+                }
 
                 std::cout << "Current batch: " << batch_num << " " << "Batch Loss: " << batch_loss << std::endl;
                 batch_num++;
@@ -190,16 +492,111 @@ class NeuralNetwork {
         }
     }
 
-    ~NeuralNetwork() {
-        delete fc1;
-        delete relu;
-        delete fc2;
-        delete softmax;
-        delete loss;
-        // delete optimizer;
-        delete optimizer1;
-        delete optimizer2;
+    /**
+     * @brief Post-training int8 model of the trained network for inference on raw pixels. The scales of the hidden
+     * @brief activations are calibrated on the given images, e.g. a sample of the training set.
+     *
+     * @param calibration_images Normalized images, one per row
+     * @param calibration_percentile Percentile of the activations of a hidden unit that maps to 255
+     * @return int8::QuantizedNetwork
+     */
+    int8::QuantizedNetwork quantize(const Tensor &calibration_images,
+                                    double calibration_percentile = int8::kCalibrationPercentile) const
+        requires(!Convolutional && HiddenLayers == 1)
+    {
+        const auto &fc1 = layers.template layer<0>();
+        const auto &fc2 = layers.template layer<1>();
+        return int8::QuantizedNetwork(Tensor(fc1.weights), Tensor(fc1.bias), Tensor(fc2.weights), Tensor(fc2.bias),
+                                      calibration_images, calibration_percentile);
+    }
+
+    /**
+     * @brief The weights and biases of all layers as one flat buffer, e.g. to checkpoint or restore them with a single
+     * @brief copy
+     *
+     * @return std::span<Scalar>
+     */
+    std::span<Scalar> parameter_values() {
+        return parameters.values();
+    }
+
+    std::span<const Scalar> parameter_values() const {
+        return parameters.values();
+    }
+
+    ~BasicNeuralNetwork() {
+        delete optimizer;
         delete weights_initializer;
         delete bias_initializer;
     }
-};
\ No newline at end of file
+};
+
+// Network with all sizes chosen at runtime
+using NeuralNetwork = BasicNeuralNetwork<>;
+
+// Hidden sizes of the MNIST topology (784 -> hidden -> 10) with a compile-time specialized network. Every entry
+// instantiates the whole training and evaluation path once per scalar type, so only the production width is listed
+using FixedHiddenSizes = std::integer_sequence<int, 500>;
+
+/**
+ * @brief Calls fn.template operator()<Network>() with the MNIST network type for the given layer sizes and scalar
+ * @brief type: the fixed-shape network if the sizes are 784 -> (one of FixedHiddenSizes) -> 10, the dynamic one
+ * @brief otherwise
+ *
+ * @param input_size
+ * @param hidden_size
+ * @param output_size
+ * @param fn Generic lambda taking the network type as template parameter
+ * @param hidden_sizes Registry of fixed hidden sizes
+ * @return bool True if a fixed-shape network was selected
+ */
+template <typename Scalar = double, typename Fn, int... HiddenSizes>
+bool dispatch_network(unsigned int input_size, unsigned int hidden_size, unsigned int output_size, Fn &&fn,
+                      std::integer_sequence<int, HiddenSizes...> hidden_sizes) {
+    bool fixed = false;
+    if (input_size == 784 && output_size == 10) {
+        fixed = ((hidden_size == unsigned(HiddenSizes) &&
+                  (fn.template operator()<BasicNeuralNetwork<784, HiddenSizes, 10, Scalar>>(), true)) ||
+                 ...);
+    }
+    if (!fixed) {
+        fn.template operator()<BasicNeuralNetwork<Eigen::Dynamic, Eigen::Dynamic, Eigen::Dynamic, Scalar>>();
+    }
+    return fixed;
+}
+
+template <typename Scalar = double, typename Fn>
+bool dispatch_network(unsigned int input_size, unsigned int hidden_size, unsigned int output_size, Fn &&fn) {
+    return dispatch_network<Scalar>(input_size, hidden_size, output_size, std::forward<Fn>(fn), FixedHiddenSizes{});
+}
+
+// Deepest stack of hidden layers that dispatch_network() instantiates
+inline constexpr int kMaxHiddenLayers = 3;
+
+/**
+ * @brief Calls fn.template operator()<Network>() with the network type for the given hidden layer widths: a single
+ * @brief hidden layer is dispatched on its width as above, deeper stacks of up to kMaxHiddenLayers layers get the
+ * @brief dynamic network of that depth
+ *
+ * @param input_size
+ * @param hidden_sizes One width per hidden layer, 1 to kMaxHiddenLayers of them (checked by the caller)
+ * @param output_size
+ * @param fn Generic lambda taking the network type as template parameter
+ * @return bool True if a fixed-shape network was selected
+ */
+template <typename Scalar = double, typename Fn>
+bool dispatch_network(unsigned int input_size, const std::vector<unsigned int> &hidden_sizes, unsigned int output_size,
+                      Fn &&fn) {
+    eigen_assert(!hidden_sizes.empty() && hidden_sizes.size() <= std::size_t(kMaxHiddenLayers));
+    if (hidden_sizes.size() == 1) {
+        return dispatch_network<Scalar>(input_size, hidden_sizes[0], output_size, std::forward<Fn>(fn));
+    }
+    [&]<int... Depth>(std::integer_sequence<int, Depth...>) {
+        ((hidden_sizes.size() == std::size_t(Depth + 2) &&
+          (fn.template operator()<BasicNeuralNetwork<Eigen::Dynamic, Eigen::Dynamic, Eigen::Dynamic, Scalar, false,
+                                                     Depth + 2>>(),
+           true)) ||
+         ...);
+    }(std::make_integer_sequence<int, kMaxHiddenLayers - 1>());
+    return false;
+}
@@ -1,57 +1,299 @@
 #pragma once
 
+#include "BaseLayer.hpp"
 #include "Eigen/Dense"
-#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
 
 using Tensor = Eigen::MatrixXd;
 
-class Optimizer
+// Elements [begin, begin + size) of a parameter
+struct ParameterRange
+{
+    Eigen::Index begin;
+    Eigen::Index size;
+};
+
+/**
+ * @brief A parameter tensor and its gradient as flat spans, which the optimizer updates in place. The optimizer state
+ * @brief of the parameter lives in its state span if it has one, e.g. in a BasicParameterArena, else in the optimizer.
+ */
+template <typename Scalar = double>
+struct BasicParameter
+{
+    std::span<Scalar> values;
+    std::span<const Scalar> gradient;
+    // state_planes() spans of the size of values, one after the other; empty to keep the state in the optimizer
+    std::span<Scalar> state;
+    // The only elements with a gradient, e.g. the weight columns of the input features of a sparse batch, in
+    // ascending order; empty for all elements. The step is lazy: the other elements and their optimizer state are
+    // left as they are, so their momentum neither decays nor moves them until they have a gradient again.
+    std::span<const ParameterRange> ranges;
+
+    BasicParameter(std::span<Scalar> values, std::span<const Scalar> gradient, std::span<Scalar> state = {})
+        : values(values), gradient(gradient), state(state)
+    {
+        eigen_assert(values.size() == gradient.size());
+    }
+
+    BasicParameter(BasicTensor<Scalar> &values, const BasicTensor<Scalar> &gradient)
+        : BasicParameter(std::span<Scalar>(values.data(), std::size_t(values.size())),
+                         std::span<const Scalar>(gradient.data(), std::size_t(gradient.size())))
+    {
+    }
+};
+
+/**
+ * @brief Optimizer for tensors of the given scalar type. Hyperparameters stay double and are rounded to Scalar
+ * @brief where they meet a tensor.
+ * @brief An instance optimizes one parameter group, e.g. the weights and bias of a layer: step() updates every
+ * @brief parameter of the group in place, and stateful optimizers keep their state per position in the group.
+ */
+template <typename Scalar = double>
+class BasicOptimizer
 {
 public:
-    virtual ~Optimizer() = default;
+    using Tensor = BasicTensor<Scalar>;
+    using Parameter = BasicParameter<Scalar>;
+    using ParamGroup = std::span<const Parameter>;
+
+    virtual ~BasicOptimizer() = default;
+
+    /**
+     * @brief One optimization step of the group, in place. It is the same group, in the same order, on every call.
+     * @param group
+     */
+    virtual void step(ParamGroup group) = 0;
+
+    /**
+     * @brief One optimization step of a group with a single parameter tensor
+     * @param values
+     * @param gradient
+     */
+    void step(Tensor &values, const Tensor &gradient)
+    {
+        const Parameter parameter(values, gradient);
+        step(ParamGroup(&parameter, 1));
+    }
+
+    /**
+     * @brief Create an optimizer with the same hyperparameters and fresh state, e.g. for another parameter group
+     * @return std::unique_ptr<BasicOptimizer>
+     */
+    virtual std::unique_ptr<BasicOptimizer> clone() const = 0;
+
+    /**
+     * @brief Set the learning rate of the next steps, e.g. from a LearningRateSchedule. The optimizer state is kept.
+     * @param learningRate
+     */
+    virtual void set_learning_rate(double learningRate) = 0;
+
+    /**
+     * @brief Number of state elements of the optimizer per parameter element, e.g. 2 for the moments of ADAM
+     * @return Eigen::Index
+     */
+    virtual Eigen::Index state_planes() const
+    {
+        return 0;
+    }
+
+protected:
+    // Parameters from this size on are updated by all threads
+    static constexpr Eigen::Index kParallelSize = Eigen::Index(1) << 16;
+
+    /**
+     * @brief Calls update(begin, size) for every range of the parameter that the step updates, see
+     * @brief BasicParameter::ranges
+     * @param parameter
+     * @param update
+     */
+    template <typename Update>
+    static void for_each_range(const Parameter &parameter, Update &&update)
+    {
+        if (parameter.ranges.empty())
+        {
+            update(Eigen::Index(0), Eigen::Index(parameter.values.size()));
+            return;
+        }
+        for (const ParameterRange &range : parameter.ranges)
+        {
+            update(range.begin, range.size);
+        }
+    }
+
+    /**
+     * @brief The zero-initialized state planes of the i-th parameter of the group: its state span if it has one, else
+     * @brief storage of the optimizer allocated on the first step, the only allocation of the optimizer
+     * @param group
+     * @param i
+     * @return Scalar*
+     */
+    Scalar *state(ParamGroup group, std::size_t i)
+    {
+        const Eigen::Index size = state_planes() * Eigen::Index(group[i].values.size());
+        if (!group[i].state.empty())
+        {
+            eigen_assert(Eigen::Index(group[i].state.size()) == size);
+            return group[i].state.data();
+        }
+        if (owned_state.size() < group.size())
+        {
+            MallocGuard allow_malloc(true);
+            owned_state.resize(group.size());
+        }
+        if (owned_state[i].size() != size)
+        {
+            eigen_assert(owned_state[i].size() == 0 && "the optimizer is stepped with another parameter group");
+            MallocGuard allow_malloc(true);
+            owned_state[i] = Eigen::Array<Scalar, Eigen::Dynamic, 1>::Zero(size);
+        }
+        return owned_state[i].data();
+    }
 
-    virtual Tensor updateWeights(Tensor &weights, Tensor &gradient) = 0;
+private:
+    std::vector<Eigen::Array<Scalar, Eigen::Dynamic, 1>> owned_state;
 };
 
-class SGD final : public Optimizer
+/**
+ * @brief Stochastic Gradient Descent, optionally with (Nesterov) momentum in the formulation of torch.optim.SGD:
+ * @brief v = momentum * v + g, then w -= lr * v, or w -= lr * (g + momentum * v) with Nesterov.
+ */
+template <typename Scalar = double>
+class BasicSGD final : public BasicOptimizer<Scalar>
 {
 private:
     double learningRate;
+    double momentum = 0.0;
+    bool nesterov = false;
 
 public:
-    SGD() : learningRate(0.001) {}
-    SGD(double learningRate) : learningRate(learningRate) {}
-    ~SGD() override {}
+    using Tensor = BasicTensor<Scalar>;
+
+    BasicSGD() : learningRate(0.001) {}
+    BasicSGD(double learningRate) : learningRate(learningRate) {}
+    /**
+     * @brief Construct SGD with momentum
+     * @param learningRate
+     * @param momentum Decay of the velocity, 0 for plain SGD
+     * @param nesterov Step along the velocity looked ahead by one update
+     */
+    BasicSGD(double learningRate, double momentum, bool nesterov = false)
+        : learningRate(learningRate), momentum(momentum), nesterov(nesterov)
+    {
+        eigen_assert((momentum > 0 || !nesterov) && "Nesterov momentum needs a momentum");
+    }
+    ~BasicSGD() override {}
+
+    using BasicOptimizer<Scalar>::step;
 
     /**
      * @author Lam Tran
      * @since 20-12-2024
      * @brief Adjust the weights using Stochastic Gradient Descent between iterations (not epochs)
+     * @param group
+     */
+    void step(typename BasicOptimizer<Scalar>::ParamGroup group) override
+    {
+        for (std::size_t i = 0; i < group.size(); ++i)
+        {
+            Scalar *velocity = momentum == 0.0 ? nullptr : this->state(group, i);
+            this->for_each_range(group[i], [&](Eigen::Index begin, Eigen::Index size) {
+                Scalar *weights = group[i].values.data() + begin;
+                const Scalar *gradient = group[i].gradient.data() + begin;
+                if (momentum == 0.0)
+                {
+                    update(weights, gradient, size);
+                }
+                else if (nesterov)
+                {
+                    update<true>(weights, gradient, velocity + begin, size);
+                }
+                else
+                {
+                    update<false>(weights, gradient, velocity + begin, size);
+                }
+            });
+        }
+    }
+
+    std::unique_ptr<BasicOptimizer<Scalar>> clone() const override
+    {
+        return std::make_unique<BasicSGD>(learningRate, momentum, nesterov);
+    }
+
+    void set_learning_rate(double learningRate) override
+    {
+        this->learningRate = learningRate;
+    }
+
+    // The velocity, with momentum
+    Eigen::Index state_planes() const override
+    {
+        return momentum == 0.0 ? 0 : 1;
+    }
+
+private:
+    /**
+     * @brief Plain SGD step
      * @param weights
      * @param gradient
-     * @return Tensor
+     * @param size Number of elements of weights and gradient
      */
-    Tensor updateWeights(Tensor &weights, Tensor &gradient) override
+    void update(Scalar *weights, const Scalar *gradient, Eigen::Index size) const
     {
-        return (weights - learningRate * gradient);
+        const Scalar rate = Scalar(learningRate);
+#pragma omp parallel for simd schedule(static) if (size >= this->kParallelSize)
+        for (Eigen::Index i = 0; i < size; ++i)
+        {
+            weights[i] -= rate * gradient[i];
+        }
+    }
+
+    /**
+     * @brief Fused momentum step: the velocity and the weights are read and written once, in one vectorized pass,
+     * @brief split over the threads for large parameters
+     * @param weights
+     * @param gradient
+     * @param velocity_data v of the weights
+     * @param size Number of elements of weights, gradient and v
+     */
+    template <bool Nesterov>
+    void update(Scalar *weights, const Scalar *gradient, Scalar *velocity_data, Eigen::Index size) const
+    {
+        const Scalar rate = Scalar(learningRate);
+        const Scalar decay = Scalar(momentum);
+#pragma omp parallel for simd schedule(static) if (size >= this->kParallelSize)
+        for (Eigen::Index i = 0; i < size; ++i)
+        {
+            const Scalar v = decay * velocity_data[i] + gradient[i];
+            velocity_data[i] = v;
+            weights[i] -= rate * (Nesterov ? gradient[i] + decay * v : v);
+        }
     }
 };
 
-class ADAM final : public Optimizer
+template <typename Scalar = double>
+class BasicADAM final : public BasicOptimizer<Scalar>
 {
+public:
+    using Tensor = BasicTensor<Scalar>;
+
 private:
     double learningRate;
     double beta1;
     double beta2;
     double epsilon;
-    Tensor m;
-    Tensor v;
-    bool uninitialized = true;
-    static inline std::mutex mtx;
-    static inline int t = 0;
+    // Number of steps of this instance, the t of the bias correction
+    long long t = 0;
+    // Elements per chunk of the fused update
+    static constexpr Eigen::Index kChunk = 512;
 
   public:
-    ADAM() : learningRate(0.001), beta1(0.9), beta2(0.999), epsilon(1e-8), uninitialized(true) {}
+    BasicADAM() : learningRate(0.001), beta1(0.9), beta2(0.999), epsilon(1e-8) {}
     /**
      * @author Lam Tran
      * @since 20-12-2024
@@ -60,41 +302,81 @@ private:
      * @param beta1 Exponential decay rate for momentum term aka first moment estimates
      * @param beta2 Exponential decay rate for velocity term aka second-moment estimates
      * @param epsilon Small value to prevent division by zero
-     * @param t Number of iterations (statically managed)
      * @param lambda Rate of decay for the moment estimates (not implemented)
      */
-    ADAM(double learningRate, double beta1, double beta2, double epsilon)
-        : learningRate(learningRate), beta1(beta1), beta2(beta2), epsilon(epsilon), uninitialized(true) {}
-    ~ADAM() override {}
+    BasicADAM(double learningRate, double beta1, double beta2, double epsilon)
+        : learningRate(learningRate), beta1(beta1), beta2(beta2), epsilon(epsilon) {}
+    ~BasicADAM() override {}
+
+    using BasicOptimizer<Scalar>::step;
 
     /**
      * @author Lam Tran
      * @since 20-12-2024
      * @brief Adjust the weights using ADAM optimization algorithm
+     * @param group
+     */
+    void step(typename BasicOptimizer<Scalar>::ParamGroup group) override {
+        ++t;
+        for (std::size_t i = 0; i < group.size(); ++i) {
+            // The state is m followed by v
+            Scalar *first_moment = this->state(group, i);
+            Scalar *second_moment = first_moment + group[i].values.size();
+            this->for_each_range(group[i], [&](Eigen::Index begin, Eigen::Index size) {
+                update(group[i].values.data() + begin, group[i].gradient.data() + begin, first_moment + begin,
+                       second_moment + begin, size);
+            });
+        }
+    }
+
+    std::unique_ptr<BasicOptimizer<Scalar>> clone() const override {
+        return std::make_unique<BasicADAM>(learningRate, beta1, beta2, epsilon);
+    }
+
+    void set_learning_rate(double learningRate) override {
+        this->learningRate = learningRate;
+    }
+
+    // The first and second moment estimates
+    Eigen::Index state_planes() const override {
+        return 2;
+    }
+
+  private:
+    /**
+     * @brief Fused ADAM step: m, v and the weights are read and written once, in one pass over chunks small enough
+     * @brief to stay in L1 between the three vectorized updates of a chunk; the chunks of large parameters are split
+     * @brief over the threads. The bias corrections are folded into the scalars, with c = sqrt(1 - beta2^t):
+     * @brief lr * m_hat / (sqrt(v_hat) + eps) = lr * c / (1 - beta1^t) * m / (sqrt(v) + eps * c)
      * @param weights
      * @param gradient
-     * @return Tensor
+     * @param first_moment m of the weights
+     * @param second_moment v of the weights
+     * @param size Number of elements of weights, gradient, m and v
      */
-    Tensor updateWeights(Tensor &weights, Tensor &gradient) override {
-        // Initialize m and v if not initialized
-        if (uninitialized) {
-            m = Tensor::Zero(weights.rows(), weights.cols());
-            v = Tensor::Zero(weights.rows(), weights.cols());
-            uninitialized = false;
-        }
+    void update(Scalar *weights, const Scalar *gradient, Scalar *first_moment, Scalar *second_moment,
+                Eigen::Index size) const {
+        using Chunk = Eigen::Map<Eigen::Array<Scalar, Eigen::Dynamic, 1>>;
+        using ConstChunk = Eigen::Map<const Eigen::Array<Scalar, Eigen::Dynamic, 1>>;
 
-        int t_temp;
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            t_temp = ++t;
-        }
+        const double correction2 = std::sqrt(1 - std::pow(beta2, t));
+        const Scalar step_size = Scalar(learningRate * correction2 / (1 - std::pow(beta1, t)));
+        const Scalar epsilon_hat = Scalar(epsilon * correction2);
 
-        m = beta1 * m + (1 - beta1) * gradient;
-        v = beta2 * v + (1 - beta2) * gradient.cwiseProduct(gradient);
-        Tensor m_hat = m / (1 - std::pow(beta1, t_temp));
-        Tensor v_hat = v / (1 - std::pow(beta2, t_temp));
-        return weights - learningRate * (m_hat.array() / (v_hat.array().sqrt() + epsilon)).matrix();
+#pragma omp parallel for schedule(static) if (size >= this->kParallelSize)
+        for (Eigen::Index begin = 0; begin < size; begin += kChunk) {
+            const Eigen::Index count = std::min(kChunk, size - begin);
+            const ConstChunk g(gradient + begin, count);
+            Chunk m_chunk(first_moment + begin, count);
+            Chunk v_chunk(second_moment + begin, count);
+            Chunk w_chunk(weights + begin, count);
+            m_chunk = Scalar(beta1) * m_chunk + Scalar(1 - beta1) * g;
+            v_chunk = Scalar(beta2) * v_chunk + Scalar(1 - beta2) * g.square();
+            w_chunk -= step_size * m_chunk / (v_chunk.sqrt() + epsilon_hat);
+        }
     }
 };
 
-// TODO: Maybe implement SGD with momentum
\ No newline at end of file
+using Optimizer = BasicOptimizer<>;
+using SGD = BasicSGD<>;
+using ADAM = BasicADAM<>;
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "BaseLayer.hpp"
+#include "Eigen/Dense"
+#include "Optimizers.hpp"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+/**
+ * @brief One flat, aligned buffer for the parameter tensors of a model, their gradients and the optimizer state.
+ * @brief The buffer is a sequence of planes of equal size: the values of all tensors, then their gradients, then the
+ * @brief state planes of the optimizer (e.g. m and v of ADAM). Every tensor starts on a cache line within a plane, and
+ * @brief layers work on Eigen::Map views of it. An optimizer then steps all parameters in one pass over the planes,
+ * @brief and a checkpoint or all-reduce of the values or gradients is a single copy of a plane.
+ * @brief Tensors are added first, then the buffer is allocated once; views stay valid when the arena is moved.
+ */
+template <typename Scalar = double>
+class BasicParameterArena
+{
+public:
+    using Tensor = BasicTensor<Scalar>;
+    using TensorMap = Eigen::Map<Tensor>;
+    using Parameter = BasicParameter<Scalar>;
+
+    // Elements per cache line, the alignment of the tensors within a plane
+    static constexpr Eigen::Index kAlignment = 64 / sizeof(Scalar);
+
+private:
+    struct Slot
+    {
+        Eigen::Index offset;
+        Eigen::Index rows;
+        Eigen::Index cols;
+    };
+
+    std::vector<Slot> slots;
+    // Elements per plane, including the padding behind every tensor
+    Eigen::Index plane_size = 0;
+    Eigen::Index state_planes = 0;
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> buffer;
+
+public:
+    /**
+     * @brief Add a rows x cols parameter tensor, before allocate()
+     * @param rows
+     * @param cols
+     * @return std::size_t Slot of the tensor for values() and gradient()
+     */
+    std::size_t add(Eigen::Index rows, Eigen::Index cols)
+    {
+        eigen_assert(buffer.size() == 0 && "tensors are added before the arena is allocated");
+        slots.push_back({plane_size, rows, cols});
+        plane_size += (rows * cols + kAlignment - 1) / kAlignment * kAlignment;
+        return slots.size() - 1;
+    }
+
+    /**
+     * @brief Allocate the zeroed planes of the added tensors
+     * @param optimizer_state_planes State planes of the optimizer that steps the arena, see
+     * @param optimizer_state_planes BasicOptimizer::state_planes()
+     */
+    void allocate(Eigen::Index optimizer_state_planes)
+    {
+        state_planes = optimizer_state_planes;
+        buffer = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>::Zero((2 + state_planes) * plane_size);
+    }
+
+    TensorMap values(std::size_t slot)
+    {
+        return TensorMap(buffer.data() + slots[slot].offset, slots[slot].rows, slots[slot].cols);
+    }
+
+    TensorMap gradient(std::size_t slot)
+    {
+        return TensorMap(buffer.data() + plane_size + slots[slot].offset, slots[slot].rows, slots[slot].cols);
+    }
+
+    // The values of all tensors, e.g. to checkpoint or broadcast them
+    std::span<Scalar> values()
+    {
+        return {buffer.data(), std::size_t(plane_size)};
+    }
+
+    std::span<const Scalar> values() const
+    {
+        return {buffer.data(), std::size_t(plane_size)};
+    }
+
+    // The gradients of all tensors, e.g. to all-reduce them
+    std::span<Scalar> gradients()
+    {
+        return {buffer.data() + plane_size, std::size_t(plane_size)};
+    }
+
+    /**
+     * @brief All tensors as a single parameter, with the optimizer state planes, for one step over the whole arena
+     * @return Parameter
+     */
+    Parameter parameter()
+    {
+        return Parameter(values(), gradients(),
+                         std::span<Scalar>(buffer.data() + 2 * plane_size, std::size_t(state_planes * plane_size)));
+    }
+
+    /**
+     * @brief All tensors as a single parameter like parameter(), of which the tensor in slot only steps the given
+     * @brief columns, e.g. the weight columns of the input features of a sparse batch (see BasicParameter::ranges)
+     * @param slot
+     * @param columns Ascending column indices of the tensor
+     * @param ranges Storage of the element ranges, which the parameter views
+     * @return Parameter
+     */
+    Parameter parameter(std::size_t slot, std::span<const Eigen::Index> columns, std::vector<ParameterRange> &ranges)
+    {
+        const Slot &tensor = slots[slot];
+        // Adjacent ranges are merged, so that the optimizer steps runs of columns in one pass
+        auto add_range = [&](Eigen::Index begin, Eigen::Index end) {
+            if (begin == end)
+            {
+                return;
+            }
+            if (!ranges.empty() && ranges.back().begin + ranges.back().size == begin)
+            {
+                ranges.back().size += end - begin;
+            }
+            else
+            {
+                ranges.push_back({begin, end - begin});
+            }
+        };
+        ranges.clear();
+        add_range(0, tensor.offset);
+        for (const Eigen::Index column : columns)
+        {
+            add_range(tensor.offset + column * tensor.rows, tensor.offset + (column + 1) * tensor.rows);
+        }
+        add_range(tensor.offset + tensor.rows * tensor.cols, plane_size);
+
+        Parameter all = parameter();
+        all.ranges = ranges;
+        return all;
+    }
+};
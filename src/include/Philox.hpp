@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Intrinsics.hpp"
+#include "Eigen/Dense"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+/**
+ * @brief Philox4x32-10 counter-based random numbers (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+ * @brief Every 128-bit counter is encrypted independently under a 64-bit key, so the numbers of element e of stream s
+ * @brief are a pure function of (key, s, e): tensors are filled in parallel and in any order, and the result does not
+ * @brief depend on the number of threads.
+ */
+namespace philox
+{
+
+using Counter = std::array<std::uint32_t, 4>;
+using Key = std::array<std::uint32_t, 2>;
+
+// Round multipliers and Weyl key increments of Philox4x32
+inline constexpr std::uint32_t MULTIPLIER0 = 0xD2511F53;
+inline constexpr std::uint32_t MULTIPLIER1 = 0xCD9E8D57;
+inline constexpr std::uint32_t WEYL0 = 0x9E3779B9;
+inline constexpr std::uint32_t WEYL1 = 0xBB67AE85;
+inline constexpr int ROUNDS = 10;
+// Counters per pass of fill_normal(): the integer rounds of a chunk run as one vectorizable loop
+inline constexpr Eigen::Index CHUNK = 256;
+
+/**
+ * @brief The ten rounds of Philox4x32 on one counter
+ * @param counter
+ * @param key
+ * @return Counter Four uniformly distributed 32-bit words
+ */
+inline Counter philox4x32(Counter counter, Key key)
+{
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        const std::uint64_t product0 = std::uint64_t(MULTIPLIER0) * counter[0];
+        const std::uint64_t product1 = std::uint64_t(MULTIPLIER1) * counter[2];
+        counter = {std::uint32_t(product1 >> 32) ^ counter[1] ^ key[0], std::uint32_t(product1),
+                   std::uint32_t(product0 >> 32) ^ counter[3] ^ key[1], std::uint32_t(product0)};
+        key = {key[0] + WEYL0, key[1] + WEYL1};
+    }
+    return counter;
+}
+
+/**
+ * @brief Fill n values with samples of N(0, sigma^2), element e taking lane e % 4 of counter (e / 4, stream) under
+ * @brief the seed. Box-Muller turns the four words of a counter into four samples. The samples are drawn in double
+ * @brief and rounded to Scalar.
+ * @param seed Key of all streams, e.g. one per model
+ * @param stream Index of the stream, e.g. one per initialized tensor
+ * @param sigma Standard deviation
+ * @param out
+ * @param n
+ */
+template <typename Scalar>
+void fill_normal(std::uint32_t seed, std::uint64_t stream, double sigma, Scalar *out, Eigen::Index n)
+{
+    const Key key = {seed, 0};
+    const Eigen::Index counters = (n + 3) / 4;
+#pragma omp parallel for schedule(static)
+    for (Eigen::Index chunk = 0; chunk < counters; chunk += CHUNK)
+    {
+        const Eigen::Index count = std::min(CHUNK, counters - chunk);
+        // Zeroed, as the Box-Muller pass transforms whole chunks and the last one has only count counters
+        std::array<std::array<std::uint32_t, CHUNK>, 4> words = {};
+        std::array<Eigen::Array<double, CHUNK, 1>, 4> samples;
+#pragma omp simd
+        for (Eigen::Index i = 0; i < count; ++i)
+        {
+            const std::uint64_t index = chunk + i;
+            const Counter bits = philox4x32({std::uint32_t(index), std::uint32_t(index >> 32), std::uint32_t(stream),
+                                             std::uint32_t(stream >> 32)},
+                                            key);
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                words[lane][i] = bits[lane];
+            }
+        }
+        // Box-Muller on whole chunks with Eigen's vectorized log, sqrt, sin and cos. The angle is taken in float,
+        // whose sin and cos vectorize, as it resolves no more than 2^-32 turns anyway.
+        for (int pair = 0; pair < 2; ++pair)
+        {
+            // Radius from a uniform in (0, 1], so the log is finite; angle from the signed word, in [-pi, pi)
+            const Eigen::Map<const Eigen::Array<std::uint32_t, CHUNK, 1>> radius_words(words[2 * pair].data());
+            const Eigen::Map<const Eigen::Array<std::int32_t, CHUNK, 1>> angle_words(
+                reinterpret_cast<const std::int32_t *>(words[2 * pair + 1].data()));
+            // The casts are evaluated on their own: in an expression with mixed types the log, sin and cos would be
+            // taken element by element
+            const Eigen::Array<double, CHUNK, 1> uniform = (radius_words.cast<double>() + 1.0) * 0x1p-32;
+            const Eigen::Array<double, CHUNK, 1> radius = sigma * (-2.0 * uniform.log()).sqrt();
+            const Eigen::Array<float, CHUNK, 1> angle =
+                angle_words.cast<float>() * float(2.0 * std::numbers::pi * 0x1p-32);
+            const Eigen::Array<float, CHUNK, 1> cosine = angle.cos();
+            const Eigen::Array<float, CHUNK, 1> sine = angle.sin();
+            samples[2 * pair] = radius * cosine.cast<double>();
+            samples[2 * pair + 1] = radius * sine.cast<double>();
+        }
+        for (Eigen::Index i = 0; i < count; ++i)
+        {
+            const Eigen::Index first = 4 * (chunk + i);
+            for (Eigen::Index lane = 0; lane < std::min<Eigen::Index>(4, n - first); ++lane)
+            {
+                out[first + lane] = Scalar(samples[lane][i]);
+            }
+        }
+    }
+}
+
+} // namespace philox
@@ -0,0 +1,656 @@
+#pragma once
+
+#include "BaseLayer.hpp"
+#include "Eigen/Dense"
+#include "Intrinsics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Post-training int8 quantization of the two-layer MNIST network for inference. Weights are quantized
+ * @brief symmetrically per output channel to int8, activations are uint8 with a per-channel scale and no zero point:
+ * @brief the raw pixels (scale 1 / 255) and the ReLU outputs are never negative. That is exactly the operand format
+ * @brief of vpdpbusd (uint8 x int8, four products summed into an int32 lane), so the kernel needs neither zero-point
+ * @brief corrections nor widening. The per-channel input scales are folded into the weights before they are
+ * @brief quantized, and the int32 sums are dequantized, or with the ReLU requantized to uint8, in one epilogue.
+ */
+namespace int8
+{
+
+// Batch x features, one sample per contiguous row: raw MNIST pixels or quantized activations
+using ByteTensor = Eigen::Matrix<std::uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+// Row blocks of a ByteTensor, e.g. a batch of the test set, bind without a copy
+using ConstByteTensorRef = Eigen::Ref<const ByteTensor>;
+// Dequantized outputs (logits), one sample per contiguous row
+using FloatTensor = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// int32 lanes of an AVX-512 vector, and bytes per lane of vpdpbusd
+inline constexpr Eigen::Index kLanes = 16;
+inline constexpr Eigen::Index kGroup = 4;
+// Register block of the AVX-512 kernel: kBlockSamples broadcast words times kBlockVectors vectors
+inline constexpr int kBlockSamples = 6;
+inline constexpr int kBlockVectors = 4;
+// Samples per block of the AVX2 kernel, which takes one vector of kLanes channels at a time
+inline constexpr int kAvx2BlockSamples = 2;
+// Percentile of the calibration activations of a hidden unit that maps to 255; the rare larger ones saturate
+inline constexpr double kCalibrationPercentile = 99.99;
+
+/**
+ * @brief Value below which the given percentage of the values lies, linearly interpolated between the two nearest
+ * @brief ranks; 100 is the maximum
+ * @param values Reordered in place
+ * @param percent
+ * @return double
+ */
+inline double percentile(std::vector<double> &values, double percent)
+{
+    eigen_assert(!values.empty() && percent >= 0 && percent <= 100);
+    const double rank = percent / 100.0 * double(values.size() - 1);
+    const auto lower = values.begin() + std::ptrdiff_t(rank);
+    std::nth_element(values.begin(), lower, values.end());
+    if (lower + 1 == values.end())
+    {
+        return *lower;
+    }
+    // The next rank is the smallest value above the lower one
+    const double upper = *std::min_element(lower + 1, values.end());
+    return *lower + (rank - std::floor(rank)) * (upper - *lower);
+}
+
+/**
+ * @brief Whether the CPU runs the VNNI kernel. The kernels are compiled for their instructions whatever -march says
+ * @brief and chosen at runtime.
+ * @return bool
+ */
+inline bool vnni_available()
+{
+#if defined(X86_KERNELS)
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni");
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Whether the CPU runs the AVX2 kernel
+ * @return bool
+ */
+inline bool avx2_available()
+{
+#if defined(X86_KERNELS)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Name of the instructions of the int8 kernel, for the log
+ * @return const char*
+ */
+inline const char *kernel_name()
+{
+    if (vnni_available())
+    {
+        return "AVX512-VNNI";
+    }
+    if (avx2_available())
+    {
+        return "AVX2";
+    }
+    return "portable";
+}
+
+/**
+ * @brief Fully connected layer with int8 weights for uint8 inputs. The weights of each output channel are packed in
+ * @brief groups of kGroup consecutive input features, kLanes channels per 64-byte vector, i.e. the weight operand of
+ * @brief vpdpbusd, zero-padded to whole groups and vectors.
+ */
+class QuantizedFullyConnected
+{
+private:
+    Eigen::Index input_size = 0;
+    Eigen::Index output_size = 0;
+    Eigen::Index groups = 0;
+    std::vector<std::int8_t> packed_weights;
+    // Real output = int32 sum * weight_scale + bias; the epilogue computes sum * multiplier + offset, which is the
+    // real output or, after requantize(), the real output in units of the output scale
+    Eigen::VectorXf weight_scale;
+    Eigen::VectorXf bias;
+    Eigen::VectorXf multiplier;
+    Eigen::VectorXf offset;
+    bool requantized = false;
+
+    Eigen::Index vectors() const
+    {
+        return (output_size + kLanes - 1) / kLanes;
+    }
+
+    std::int8_t &packed_weight(Eigen::Index output, Eigen::Index feature)
+    {
+        return packed_weights[((output / kLanes * groups + feature / kGroup) * kLanes + output % kLanes) * kGroup +
+                              feature % kGroup];
+    }
+
+    /**
+     * @brief Four input bytes of a group as the broadcast operand of vpdpbusd; the last group of an input size that
+     * @brief is not a multiple of kGroup is completed with zeros
+     */
+    std::int32_t input_word(const std::uint8_t *row, Eigen::Index group) const
+    {
+        std::int32_t word = 0;
+        std::memcpy(&word, row + group * kGroup, std::min(kGroup, input_size - group * kGroup));
+        return word;
+    }
+
+    static void store(float value, float *out)
+    {
+        *out = value;
+    }
+
+    static void store(float value, std::uint8_t *out)
+    {
+        *out = static_cast<std::uint8_t>(std::clamp(std::nearbyint(value), 0.0f, 255.0f));
+    }
+
+#if defined(X86_KERNELS)
+    /**
+     * @brief S x V block of the VNNI kernel: S samples (broadcast input words) times V vectors of kLanes output
+     * @brief channels, accumulated in int32 registers over all groups, then dequantized (float output) or
+     * @brief requantized with ReLU and unsigned saturation (uint8 output)
+     */
+    template <int S, int V, typename Out>
+    __attribute__((target("avx512f,avx512vnni"))) void vnni_block(const std::uint8_t *input, Eigen::Index ldi,
+                                                                  Eigen::Index vector0, Out *output,
+                                                                  Eigen::Index ldo) const
+    {
+        __m512i acc[S][V];
+        for (int s = 0; s < S; ++s)
+        {
+            for (int v = 0; v < V; ++v)
+            {
+                acc[s][v] = _mm512_setzero_si512();
+            }
+        }
+        const std::int8_t *weights = packed_weights.data() + vector0 * groups * kLanes * kGroup;
+        const Eigen::Index full_groups = input_size / kGroup;
+        // A lambda does not inherit the target of the function it is defined in
+        const auto step = [&](Eigen::Index g, const std::int32_t *words)
+                              __attribute__((target("avx512f,avx512vnni"))) {
+            __m512i w[V];
+            for (int v = 0; v < V; ++v)
+            {
+                w[v] = _mm512_loadu_si512(weights + (v * groups + g) * kLanes * kGroup);
+            }
+            for (int s = 0; s < S; ++s)
+            {
+                const __m512i x = _mm512_set1_epi32(words[s]);
+                for (int v = 0; v < V; ++v)
+                {
+                    acc[s][v] = _mm512_dpbusd_epi32(acc[s][v], x, w[v]);
+                }
+            }
+        };
+        std::int32_t words[S];
+        for (Eigen::Index g = 0; g < full_groups; ++g)
+        {
+            for (int s = 0; s < S; ++s)
+            {
+                std::memcpy(&words[s], input + s * ldi + g * kGroup, kGroup);
+            }
+            step(g, words);
+        }
+        if (full_groups < groups)
+        {
+            for (int s = 0; s < S; ++s)
+            {
+                words[s] = input_word(input + s * ldi, full_groups);
+            }
+            step(full_groups, words);
+        }
+
+        for (int v = 0; v < V; ++v)
+        {
+            const Eigen::Index channel = (vector0 + v) * kLanes;
+            const __mmask16 valid = __mmask16((1u << std::min(kLanes, output_size - channel)) - 1);
+            const __m512 scale = _mm512_loadu_ps(multiplier.data() + channel);
+            const __m512 shift = _mm512_loadu_ps(offset.data() + channel);
+            for (int s = 0; s < S; ++s)
+            {
+                const __m512 value = _mm512_fmadd_ps(_mm512_cvtepi32_ps(acc[s][v]), scale, shift);
+                if constexpr (std::is_same_v<Out, float>)
+                {
+                    _mm512_mask_storeu_ps(output + s * ldo + channel, valid, value);
+                }
+                else
+                {
+                    // ReLU as the lower clamp, vpmovusdb saturates at 255
+                    const __m512i rounded = _mm512_max_epi32(_mm512_cvtps_epi32(value), _mm512_setzero_si512());
+                    _mm512_mask_cvtusepi32_storeu_epi8(output + s * ldo + channel, valid, rounded);
+                }
+            }
+        }
+    }
+
+    template <int V, typename Out>
+    __attribute__((target("avx512f,avx512vnni"))) void vnni_block(int samples, const std::uint8_t *input,
+                                                                  Eigen::Index ldi, Eigen::Index vector0, Out *output,
+                                                                  Eigen::Index ldo) const
+    {
+        static_assert(kBlockSamples == 6);
+        switch (samples)
+        {
+        case 1: vnni_block<1, V>(input, ldi, vector0, output, ldo); break;
+        case 2: vnni_block<2, V>(input, ldi, vector0, output, ldo); break;
+        case 3: vnni_block<3, V>(input, ldi, vector0, output, ldo); break;
+        case 4: vnni_block<4, V>(input, ldi, vector0, output, ldo); break;
+        case 5: vnni_block<5, V>(input, ldi, vector0, output, ldo); break;
+        default: vnni_block<6, V>(input, ldi, vector0, output, ldo); break;
+        }
+    }
+
+    template <typename Out>
+    __attribute__((target("avx512f,avx512vnni"))) void vnni_block(int samples, int vectors, const std::uint8_t *input,
+                                                                  Eigen::Index ldi, Eigen::Index vector0, Out *output,
+                                                                  Eigen::Index ldo) const
+    {
+        static_assert(kBlockVectors == 4);
+        switch (vectors)
+        {
+        case 1: vnni_block<1>(samples, input, ldi, vector0, output, ldo); break;
+        case 2: vnni_block<2>(samples, input, ldi, vector0, output, ldo); break;
+        case 3: vnni_block<3>(samples, input, ldi, vector0, output, ldo); break;
+        default: vnni_block<4>(samples, input, ldi, vector0, output, ldo); break;
+        }
+    }
+
+    /**
+     * @brief S samples times one vector of kLanes output channels without VNNI. vpmaddubsw would saturate its int16
+     * @brief pair sums for the full uint8 x int8 range, so both operands are widened to int16 and multiplied with
+     * @brief vpmaddwd instead, which sums each pair of products exactly into an int32 lane. A channel accumulates in
+     * @brief two lanes, which vphaddd combines in the epilogue.
+     */
+    template <int S, typename Out>
+    __attribute__((target("avx2,fma"))) void avx2_block(const std::uint8_t *input, Eigen::Index ldi,
+                                                        Eigen::Index vector, Out *output, Eigen::Index ldo) const
+    {
+        // acc[s][q]: pair sums of the channels 4q to 4q + 3 of the vector, two lanes per channel
+        __m256i acc[S][4];
+        for (int s = 0; s < S; ++s)
+        {
+            for (int q = 0; q < 4; ++q)
+            {
+                acc[s][q] = _mm256_setzero_si256();
+            }
+        }
+        const std::int8_t *weights = packed_weights.data() + vector * groups * kLanes * kGroup;
+        const Eigen::Index full_groups = input_size / kGroup;
+        const auto step = [&](Eigen::Index g, const std::int32_t *words) __attribute__((target("avx2,fma"))) {
+            __m256i w[4];
+            for (int q = 0; q < 4; ++q)
+            {
+                w[q] = _mm256_cvtepi8_epi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + (g * kLanes + 4 * q) * kGroup)));
+            }
+            for (int s = 0; s < S; ++s)
+            {
+                // The four input bytes of the group, widened and repeated for each of the four channels
+                const __m256i x = _mm256_cvtepu8_epi16(_mm_set1_epi32(words[s]));
+                for (int q = 0; q < 4; ++q)
+                {
+                    acc[s][q] = _mm256_add_epi32(acc[s][q], _mm256_madd_epi16(x, w[q]));
+                }
+            }
+        };
+        std::int32_t words[S];
+        for (Eigen::Index g = 0; g < full_groups; ++g)
+        {
+            for (int s = 0; s < S; ++s)
+            {
+                std::memcpy(&words[s], input + s * ldi + g * kGroup, kGroup);
+            }
+            step(g, words);
+        }
+        if (full_groups < groups)
+        {
+            for (int s = 0; s < S; ++s)
+            {
+                words[s] = input_word(input + s * ldi, full_groups);
+            }
+            step(full_groups, words);
+        }
+
+        for (int half = 0; half < 2; ++half)
+        {
+            const Eigen::Index channel = vector * kLanes + half * 8;
+            const Eigen::Index valid = std::min<Eigen::Index>(8, output_size - channel);
+            if (valid <= 0)
+            {
+                break;
+            }
+            const __m256 scale = _mm256_loadu_ps(multiplier.data() + channel);
+            const __m256 shift = _mm256_loadu_ps(offset.data() + channel);
+            for (int s = 0; s < S; ++s)
+            {
+                // vphaddd sums the lane pairs within 128-bit halves, giving the channels in the order 0 1 4 5 2 3 6 7
+                const __m256i sums = _mm256_permute4x64_epi64(
+                    _mm256_hadd_epi32(acc[s][2 * half], acc[s][2 * half + 1]), 0b11011000);
+                alignas(32) float values[8];
+                _mm256_store_ps(values, _mm256_fmadd_ps(_mm256_cvtepi32_ps(sums), scale, shift));
+                for (Eigen::Index i = 0; i < valid; ++i)
+                {
+                    store(values[i], output + s * ldo + channel + i);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief gemm() with the VNNI kernel, in blocks of kBlockSamples samples times kBlockVectors vectors
+     */
+    template <typename Out>
+    __attribute__((target("avx512f,avx512vnni"))) void vnni_gemm(const ConstByteTensorRef &input, Out *output,
+                                                                 Eigen::Index ldo) const
+    {
+        const Eigen::Index batch_size = input.rows();
+        const Eigen::Index sample_blocks = (batch_size + kBlockSamples - 1) / kBlockSamples;
+        const Eigen::Index vector_blocks = (vectors() + kBlockVectors - 1) / kBlockVectors;
+#pragma omp parallel for collapse(2) schedule(static)
+        for (Eigen::Index sample_block = 0; sample_block < sample_blocks; ++sample_block)
+        {
+            for (Eigen::Index vector_block = 0; vector_block < vector_blocks; ++vector_block)
+            {
+                const Eigen::Index sample0 = sample_block * kBlockSamples;
+                const Eigen::Index vector0 = vector_block * kBlockVectors;
+                vnni_block(int(std::min<Eigen::Index>(kBlockSamples, batch_size - sample0)),
+                           int(std::min<Eigen::Index>(kBlockVectors, vectors() - vector0)),
+                           input.data() + sample0 * input.outerStride(), input.outerStride(), vector0,
+                           output + sample0 * ldo, ldo);
+            }
+        }
+    }
+
+    /**
+     * @brief gemm() with the AVX2 kernel, in blocks of kAvx2BlockSamples samples times one vector
+     */
+    template <typename Out>
+    __attribute__((target("avx2,fma"))) void avx2_gemm(const ConstByteTensorRef &input, Out *output,
+                                                       Eigen::Index ldo) const
+    {
+        const Eigen::Index batch_size = input.rows();
+        const Eigen::Index sample_blocks = (batch_size + kAvx2BlockSamples - 1) / kAvx2BlockSamples;
+        static_assert(kAvx2BlockSamples == 2);
+#pragma omp parallel for collapse(2) schedule(static)
+        for (Eigen::Index sample_block = 0; sample_block < sample_blocks; ++sample_block)
+        {
+            for (Eigen::Index vector = 0; vector < vectors(); ++vector)
+            {
+                const Eigen::Index sample0 = sample_block * kAvx2BlockSamples;
+                const std::uint8_t *block_input = input.data() + sample0 * input.outerStride();
+                if (batch_size - sample0 >= 2)
+                {
+                    avx2_block<2>(block_input, input.outerStride(), vector, output + sample0 * ldo, ldo);
+                }
+                else
+                {
+                    avx2_block<1>(block_input, input.outerStride(), vector, output + sample0 * ldo, ldo);
+                }
+            }
+        }
+    }
+#endif
+
+    /**
+     * @brief output(b, n) = epilogue(sum over k of input(b, k) * weight(n, k)) for all samples of the batch
+     * @param input Batch x input_size
+     * @param output Row-major, batch x at least output_size, leading dimension ldo
+     * @param ldo
+     */
+    template <typename Out>
+    void gemm(const ConstByteTensorRef &input, Out *output, Eigen::Index ldo) const
+    {
+        eigen_assert(input.cols() == input_size);
+#if defined(X86_KERNELS)
+        if (vnni_available())
+        {
+            vnni_gemm(input, output, ldo);
+            return;
+        }
+        if (avx2_available())
+        {
+            avx2_gemm(input, output, ldo);
+            return;
+        }
+#endif
+        const Eigen::Index batch_size = input.rows();
+#pragma omp parallel for collapse(2) schedule(static)
+        for (Eigen::Index b = 0; b < batch_size; ++b)
+        {
+            for (Eigen::Index vector = 0; vector < vectors(); ++vector)
+            {
+                // The kLanes channels of a vector side by side, so that the compiler vectorizes over them
+                std::int32_t sum[kLanes] = {};
+                const std::int8_t *weights = packed_weights.data() + vector * groups * kLanes * kGroup;
+                for (Eigen::Index g = 0; g < groups; ++g)
+                {
+                    const std::int32_t word = input_word(input.data() + b * input.outerStride(), g);
+                    std::uint8_t x[kGroup];
+                    std::memcpy(x, &word, kGroup);
+                    for (Eigen::Index lane = 0; lane < kLanes; ++lane)
+                    {
+                        for (Eigen::Index i = 0; i < kGroup; ++i)
+                        {
+                            sum[lane] += std::int32_t(x[i]) * weights[(g * kLanes + lane) * kGroup + i];
+                        }
+                    }
+                }
+                const Eigen::Index channel = vector * kLanes;
+                for (Eigen::Index lane = 0; lane < std::min(kLanes, output_size - channel); ++lane)
+                {
+                    store(float(sum[lane]) * multiplier[channel + lane] + offset[channel + lane],
+                          output + b * ldo + channel + lane);
+                }
+            }
+        }
+    }
+
+public:
+    QuantizedFullyConnected() = default;
+
+    /**
+     * @brief Quantize the weights of a fully connected layer for inputs quantized with the given per-feature scales:
+     * @brief each weight is multiplied with the scale of its input feature, and every output channel gets the
+     * @brief symmetric int8 scale max |w| / 127 of its scaled weights
+     * @param weights Output x input, as stored by FullyConnected
+     * @param bias Output x 1
+     * @param input_scales Real value of one input step per input feature
+     */
+    template <typename Weights, typename Bias>
+    QuantizedFullyConnected(const Eigen::MatrixBase<Weights> &weights, const Eigen::MatrixBase<Bias> &bias,
+                            const Eigen::VectorXd &input_scales)
+        : input_size(weights.cols()), output_size(weights.rows()), groups((weights.cols() + kGroup - 1) / kGroup)
+    {
+        eigen_assert(input_scales.size() == input_size && bias.size() == output_size);
+        const Eigen::MatrixXd scaled = weights.template cast<double>() * input_scales.asDiagonal();
+        const Eigen::VectorXd max_weight = scaled.cwiseAbs().rowwise().maxCoeff();
+
+        packed_weights.assign(vectors() * kLanes * groups * kGroup, 0);
+        // Scale, bias and epilogue vectors are padded to whole vectors for the unmasked loads of the kernel
+        weight_scale = Eigen::VectorXf::Zero(vectors() * kLanes);
+        this->bias = Eigen::VectorXf::Zero(vectors() * kLanes);
+        for (Eigen::Index n = 0; n < output_size; ++n)
+        {
+            // A channel of zero weights keeps any scale
+            const double scale = max_weight[n] > 0 ? max_weight[n] / 127.0 : 1.0;
+            for (Eigen::Index k = 0; k < input_size; ++k)
+            {
+                packed_weight(n, k) = static_cast<std::int8_t>(std::clamp(std::nearbyint(scaled(n, k) / scale),
+                                                                          -127.0, 127.0));
+            }
+            weight_scale[n] = float(scale);
+            this->bias[n] = float(bias(n));
+        }
+        multiplier = weight_scale;
+        offset = this->bias;
+    }
+
+    Eigen::Index rows() const
+    {
+        return output_size;
+    }
+
+    Eigen::Index cols() const
+    {
+        return input_size;
+    }
+
+    /**
+     * @brief Make the uint8 forward pass requantize its outputs with the given per-channel scales (real value of one
+     * @brief output step), so that they can feed the next quantized layer
+     * @param output_scales
+     */
+    void requantize(const Eigen::VectorXd &output_scales)
+    {
+        eigen_assert(output_scales.size() == output_size);
+        requantized = true;
+        for (Eigen::Index n = 0; n < output_size; ++n)
+        {
+            multiplier[n] = float(weight_scale[n] / output_scales[n]);
+            offset[n] = float(bias[n] / output_scales[n]);
+        }
+    }
+
+    /**
+     * @brief Dequantized forward pass, input * W^T + bias in float
+     * @param input Batch x input_size
+     * @param output Resized to batch x output_size
+     */
+    void forward(const ConstByteTensorRef &input, FloatTensor &output) const
+    {
+        eigen_assert(!requantized && "forward to float needs a layer without requantize()");
+        output.resize(input.rows(), output_size);
+        gemm(input, output.data(), output_size);
+    }
+
+    /**
+     * @brief Forward pass with ReLU, requantized to uint8 with the scales of requantize()
+     * @param input Batch x input_size
+     * @param output Resized to batch x output_size
+     */
+    void forward_relu(const ConstByteTensorRef &input, ByteTensor &output) const
+    {
+        eigen_assert(requantized && "forward_relu needs the output scales of requantize()");
+        output.resize(input.rows(), output_size);
+        gemm(input, output.data(), output_size);
+    }
+};
+
+/**
+ * @brief int8 inference model of the network 784 -> hidden (ReLU) -> 10, for uint8 pixels as they are stored in the
+ * @brief MNIST files. The hidden activations are calibrated per channel: the scale of hidden unit n is the
+ * @brief kCalibrationPercentile percentile of the activations of n over the calibration images divided by 255, so a
+ * @brief single outlier does not coarsen the steps of all other activations; the few above saturate at 255. These
+ * @brief scales requantize the output of the first layer and are folded into the weights of the second.
+ */
+class QuantizedNetwork
+{
+private:
+    QuantizedFullyConnected fc1;
+    QuantizedFullyConnected fc2;
+    // Quantized hidden activations of the last batch
+    ByteTensor hidden;
+
+public:
+    /**
+     * @brief Quantize a trained network, calibrating the hidden activations on a sample of training images
+     * @param fc1_weights Hidden x input
+     * @param fc1_bias
+     * @param fc2_weights Output x hidden
+     * @param fc2_bias
+     * @param calibration_images Normalized images (pixel / 255), one per row
+     * @param calibration_percentile Percentile of the activations of a hidden unit that maps to 255
+     */
+    template <typename Scalar>
+    QuantizedNetwork(const BasicTensor<Scalar> &fc1_weights, const BasicTensor<Scalar> &fc1_bias,
+                     const BasicTensor<Scalar> &fc2_weights, const BasicTensor<Scalar> &fc2_bias,
+                     const BasicTensor<Scalar> &calibration_images,
+                     double calibration_percentile = kCalibrationPercentile)
+    {
+        const Eigen::VectorXd pixel_scales = Eigen::VectorXd::Constant(fc1_weights.cols(), 1.0 / 255.0);
+        fc1 = QuantizedFullyConnected(fc1_weights, fc1_bias, pixel_scales);
+
+        const BasicTensor<Scalar> activations =
+            ((calibration_images * fc1_weights.transpose()).rowwise() + fc1_bias.col(0).transpose())
+                .cwiseMax(Scalar(0));
+        Eigen::VectorXd hidden_scales(activations.cols());
+        std::vector<double> unit_activations(activations.rows());
+        for (Eigen::Index n = 0; n < activations.cols(); ++n)
+        {
+            Eigen::Map<Eigen::VectorXd>(unit_activations.data(), activations.rows()) =
+                activations.col(n).template cast<double>();
+            hidden_scales[n] = percentile(unit_activations, calibration_percentile) / 255.0;
+        }
+        // A unit that never fires on the calibration images keeps any scale
+        hidden_scales = (hidden_scales.array() > 0).select(hidden_scales, 1.0);
+        fc1.requantize(hidden_scales);
+
+        fc2 = QuantizedFullyConnected(fc2_weights, fc2_bias, hidden_scales);
+    }
+
+    /**
+     * @brief Logits for a batch of uint8 images. Their argmax is the prediction, the same as of the probabilities.
+     * @param images Batch x 784 raw pixels
+     * @param logits Resized to batch x 10
+     */
+    void forward(const ConstByteTensorRef &images, FloatTensor &logits)
+    {
+        fc1.forward_relu(images, hidden);
+        fc2.forward(hidden, logits);
+    }
+
+    /**
+     * @brief Evaluate the quantized model on the test set, in the log format of NeuralNetwork::evaluate()
+     * @param test_images Raw pixels, one image per row
+     * @param test_labels One-hot labels
+     * @param batch_size
+     * @param log_file
+     * @return double Accuracy in percent
+     */
+    template <typename Labels>
+    double evaluate(const ByteTensor &test_images, const Labels &test_labels, unsigned int batch_size,
+                    const std::string &log_file)
+    {
+        std::ofstream log_stream(log_file);
+        unsigned int correct_count = 0;
+        FloatTensor logits;
+        for (Eigen::Index batch_start = 0; batch_start < test_images.rows(); batch_start += batch_size)
+        {
+            log_stream << "Current batch: " << batch_start / batch_size << std::endl;
+
+            const Eigen::Index rows = std::min<Eigen::Index>(batch_size, test_images.rows() - batch_start);
+            forward(test_images.middleRows(batch_start, rows), logits);
+
+            for (Eigen::Index i = 0; i < rows; i++)
+            {
+                int predicted_label = 0, actual_label = 0;
+                logits.row(i).maxCoeff(&predicted_label);
+                test_labels.row(batch_start + i).maxCoeff(&actual_label);
+
+                log_stream << " - image " << (batch_start + i) << ": Prediction=" << predicted_label
+                           << ". Label=" << actual_label << std::endl;
+
+                if (predicted_label == actual_label)
+                    correct_count++;
+            }
+        }
+        return (static_cast<double>(correct_count) / test_images.rows()) * 100.0;
+    }
+};
+
+} // namespace int8
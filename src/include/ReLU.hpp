@@ -2,17 +2,26 @@
 
 #include "BaseLayer.hpp"
 #include "Eigen/Dense"
+#include <optional>
 
 using Tensor = Eigen::MatrixXd;
 
-class ReLU final : public BaseLayer
+template <typename Scalar = double>
+class BasicReLU final : public BasicBaseLayer<Scalar>
 {
+public:
+    using Tensor = BasicTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+
 private:
     Tensor relu_cache;
+    // Input of the last buffer based forward pass; its sign pattern is the mask of the backward pass
+    std::optional<ConstTensorRef> input_ref;
 
 public:
-    ReLU() : BaseLayer() {}
-    ~ReLU() {}
+    BasicReLU() : BasicBaseLayer<Scalar>() {}
+    ~BasicReLU() {}
 
     /**
      * @author Lam Tran
@@ -23,8 +32,8 @@ public:
      */
     Tensor forward(const Tensor &input_tensor) override
     {
-        this->relu_cache = (input_tensor.array() > 0).cast<double>();
-        return input_tensor.cwiseMax(0.0);
+        this->relu_cache = (input_tensor.array() > 0).template cast<Scalar>();
+        return input_tensor.cwiseMax(Scalar(0));
     }
 
     /**
@@ -40,4 +49,29 @@ public:
     {
         return error_tensor.cwiseProduct(this->relu_cache);
     }
-};
\ No newline at end of file
+
+    /**
+     * @brief ReLU into a caller-provided buffer. Keeps a view of the input instead of a mask.
+     *
+     * @param input Input tensor from the predecessor layer
+     * @param output
+     */
+    void forward(const ConstTensorRef &input, TensorRef output) override
+    {
+        input_ref.emplace(input);
+        output = input.cwiseMax(Scalar(0));
+    }
+
+    /**
+     * @brief Pass the error through where the input of the buffer based forward pass was positive
+     *
+     * @param error Error tensor from the successor layer
+     * @param error_prev
+     */
+    void backward(const ConstTensorRef &error, TensorRef error_prev) override
+    {
+        error_prev = (input_ref->array() > 0).select(error, Scalar(0));
+    }
+};
+
+using ReLU = BasicReLU<>;
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+/**
+ * @brief Learning rate of every optimizer step of a training run, counted from 0 over all epochs. The network sets
+ * @brief it on its optimizer before each step; schedules given in epochs are converted to steps by the caller.
+ * @brief Except for the one-cycle schedule, which has its own warmup phase, the rate ramps up linearly from
+ * @brief base_rate / warmup_steps over the first warmup_steps steps.
+ */
+class LearningRateSchedule
+{
+protected:
+    double base_rate;
+    long long warmup_steps;
+
+    /**
+     * @brief Cosine annealing from start to end as progress goes from 0 to 1
+     * @param start
+     * @param end
+     * @param progress
+     * @return double
+     */
+    static double cosine(double start, double end, double progress)
+    {
+        return end + (start - end) * (1 + std::cos(std::numbers::pi * std::clamp(progress, 0.0, 1.0))) / 2;
+    }
+
+    // Rate of a step after the warmup
+    virtual double decayed_rate(long long step) const = 0;
+
+public:
+    LearningRateSchedule(double base_rate, long long warmup_steps = 0)
+        : base_rate(base_rate), warmup_steps(warmup_steps)
+    {
+    }
+    virtual ~LearningRateSchedule() = default;
+
+    /**
+     * @brief Learning rate of the given step
+     * @param step
+     * @return double
+     */
+    virtual double learning_rate(long long step) const
+    {
+        if (step < warmup_steps)
+        {
+            return base_rate * double(step + 1) / double(warmup_steps);
+        }
+        return decayed_rate(step);
+    }
+};
+
+// The base rate after the warmup
+class ConstantSchedule final : public LearningRateSchedule
+{
+protected:
+    double decayed_rate(long long) const override
+    {
+        return base_rate;
+    }
+
+public:
+    ConstantSchedule(double base_rate, long long warmup_steps = 0) : LearningRateSchedule(base_rate, warmup_steps) {}
+};
+
+/**
+ * @brief Step decay: the rate is multiplied by gamma every step_size steps after the warmup
+ */
+class StepSchedule final : public LearningRateSchedule
+{
+private:
+    long long step_size;
+    double gamma;
+
+protected:
+    double decayed_rate(long long step) const override
+    {
+        return base_rate * std::pow(gamma, double((step - warmup_steps) / step_size));
+    }
+
+public:
+    StepSchedule(double base_rate, long long step_size, double gamma, long long warmup_steps = 0)
+        : LearningRateSchedule(base_rate, warmup_steps), step_size(std::max(step_size, 1LL)), gamma(gamma)
+    {
+    }
+};
+
+/**
+ * @brief Cosine annealing from the base rate to min_rate over the steps after the warmup (SGDR without restarts)
+ */
+class CosineSchedule final : public LearningRateSchedule
+{
+private:
+    long long total_steps;
+    double min_rate;
+
+protected:
+    double decayed_rate(long long step) const override
+    {
+        const long long decay_steps = std::max(total_steps - warmup_steps, 1LL);
+        return cosine(base_rate, min_rate, double(step - warmup_steps) / double(decay_steps));
+    }
+
+public:
+    CosineSchedule(double base_rate, long long total_steps, double min_rate = 0.0, long long warmup_steps = 0)
+        : LearningRateSchedule(base_rate, warmup_steps), total_steps(total_steps), min_rate(min_rate)
+    {
+    }
+};
+
+/**
+ * @brief One-cycle policy (Smith & Topin, in the formulation of torch.optim.lr_scheduler.OneCycleLR): over the first
+ * @brief pct_start of the steps the rate anneals from max_rate / div_factor up to max_rate, over the rest down to
+ * @brief max_rate / (div_factor * final_div_factor), both along a cosine
+ */
+class OneCycleSchedule final : public LearningRateSchedule
+{
+private:
+    long long total_steps;
+    double pct_start;
+    double div_factor;
+    double final_div_factor;
+
+protected:
+    double decayed_rate(long long step) const override
+    {
+        const double initial_rate = base_rate / div_factor;
+        const double rise_steps = std::max(pct_start * double(total_steps) - 1, 1.0);
+        const double fall_steps = std::max(double(total_steps) - 1 - rise_steps, 1.0);
+        if (double(step) <= rise_steps)
+        {
+            return cosine(initial_rate, base_rate, double(step) / rise_steps);
+        }
+        return cosine(base_rate, initial_rate / final_div_factor, (double(step) - rise_steps) / fall_steps);
+    }
+
+public:
+    OneCycleSchedule(double max_rate, long long total_steps, double pct_start = 0.3, double div_factor = 25.0,
+                     double final_div_factor = 1e4)
+        : LearningRateSchedule(max_rate), total_steps(total_steps), pct_start(pct_start), div_factor(div_factor),
+          final_div_factor(final_div_factor)
+    {
+    }
+};
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "BaseLayer.hpp"
+#include "Eigen/Dense"
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Pipeline of layers composed at compile time. The layers are held by value in a std::tuple and run in order
+ * @brief on the workspaces of the pipeline, an activation and an error tensor per boundary between two layers.
+ * @brief Every call goes to the concrete (final) layer type, so it binds statically and can be inlined across the
+ * @brief layer boundaries; the number of layers and their widths are part of the type, e.g.
+ * @brief BasicSequential<FullyConnectedReLU, FullyConnectedReLU, FullyConnected> for two hidden layers.
+ * @brief Elementwise work that follows a fully connected layer is best fused into it (ReLUEpilogue) instead of
+ * @brief being a layer of its own, which costs one more pass over the activations and one more workspace.
+ */
+template <typename... Layers>
+class BasicSequential
+{
+    static_assert(sizeof...(Layers) > 0, "a pipeline needs at least one layer");
+
+public:
+    using Scalar = typename std::tuple_element_t<0, std::tuple<Layers...>>::Tensor::Scalar;
+    using Tensor = BasicTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+
+    static constexpr std::size_t size = sizeof...(Layers);
+
+    static_assert((std::is_base_of_v<BasicBaseLayer<Scalar>, Layers> && ...),
+                  "all layers of a pipeline need the same scalar type");
+
+private:
+    std::tuple<Layers...> layers;
+    // Features per sample of the input and of the output of every layer
+    std::array<Eigen::Index, size + 1> widths;
+    // Output of layer i and its error tensor, for every layer but the last one, which writes to the caller's buffers
+    std::array<Tensor, size - 1> activations;
+    std::array<Tensor, size - 1> errors;
+
+public:
+    /**
+     * @brief Construct the pipeline from its layers, the first one reading inputs with input_width features
+     *
+     * @param input_width
+     * @param pipeline The layers in the order of the forward pass
+     */
+    BasicSequential(Eigen::Index input_width, Layers... pipeline) : layers(std::move(pipeline)...)
+    {
+        widths[0] = input_width;
+        std::size_t i = 0;
+        for_each([&](const auto &layer) {
+            widths[i + 1] = layer.output_width(widths[i]);
+            ++i;
+        });
+    }
+
+    /**
+     * @brief Layer I of the pipeline
+     */
+    template <std::size_t I> auto &layer()
+    {
+        return std::get<I>(layers);
+    }
+
+    template <std::size_t I> const auto &layer() const
+    {
+        return std::get<I>(layers);
+    }
+
+    /**
+     * @brief Calls fn on every layer, in the order of the forward pass
+     *
+     * @param fn Generic lambda taking a layer
+     */
+    template <typename Fn> void for_each(Fn &&fn)
+    {
+        std::apply([&](auto &...layer) { (fn(layer), ...); }, layers);
+    }
+
+    template <typename Fn> void for_each(Fn &&fn) const
+    {
+        std::apply([&](const auto &...layer) { (fn(layer), ...); }, layers);
+    }
+
+    /**
+     * @brief Features per sample of the output of the last layer
+     *
+     * @return Eigen::Index
+     */
+    Eigen::Index output_width() const
+    {
+        return widths[size];
+    }
+
+    /**
+     * @brief Sizes the workspaces of the pipeline and of all its layers for batches of up to max_batch_size samples
+     *
+     * @param max_batch_size
+     */
+    void reserve(Eigen::Index max_batch_size)
+    {
+        for (std::size_t i = 0; i + 1 < size; ++i)
+        {
+            if (activations[i].rows() < max_batch_size)
+            {
+                activations[i].resize(max_batch_size, widths[i + 1]);
+                errors[i].resize(max_batch_size, widths[i + 1]);
+            }
+        }
+        for_each([&](auto &layer) { layer.reserve(max_batch_size); });
+    }
+
+    /**
+     * @brief Allocating forward pass, e.g. for a sparse input batch that only the first layer reads
+     *
+     * @param input_tensor
+     * @return Tensor
+     */
+    template <typename Input> Tensor forward(const Input &input_tensor)
+    {
+        return forward_allocating<1>(std::get<0>(layers).forward(input_tensor));
+    }
+
+    /**
+     * @brief Allocating backward pass after an allocating forward pass
+     *
+     * @param error_tensor Error tensor of the output of the last layer
+     * @return Tensor Error tensor of the input of the first layer
+     */
+    Tensor backward(const Tensor &error_tensor)
+    {
+        return backward_allocating<size - 1>(error_tensor);
+    }
+
+    /**
+     * @brief Forward pass into a caller-provided buffer, through the workspaces sized by reserve(). The input is
+     * passed on to the first layer as is, so e.g. a row-major batch reaches a fully connected layer without a copy.
+     * As for the layers, input must stay alive and unchanged until backward() has run.
+     *
+     * @param input Batch x input features
+     * @param output Batch x output features of the last layer
+     */
+    template <typename Input> void forward(const Input &input, TensorRef output)
+    {
+        forward_from<0>(input, output);
+    }
+
+    /**
+     * @brief Backward pass into a caller-provided buffer, after a buffer based forward pass
+     *
+     * @param error Error tensor of the output of the last layer
+     * @param error_input Error tensor of the input; empty to skip it in the first layer
+     */
+    void backward(const ConstTensorRef &error, TensorRef error_input)
+    {
+        backward_from<size - 1>(error, error_input);
+    }
+
+private:
+    template <std::size_t I, typename Input> void forward_from(const Input &input, TensorRef output)
+    {
+        auto &layer = std::get<I>(layers);
+        if constexpr (I + 1 == size)
+        {
+            layer.forward(input, output);
+        }
+        else
+        {
+            auto activation = activations[I].topRows(input.rows());
+            layer.forward(input, activation);
+            forward_from<I + 1>(activation, output);
+        }
+    }
+
+    template <std::size_t I, typename Error> void backward_from(const Error &error, TensorRef error_input)
+    {
+        auto &layer = std::get<I>(layers);
+        if constexpr (I == 0)
+        {
+            layer.backward(error, error_input);
+        }
+        else
+        {
+            auto error_prev = errors[I - 1].topRows(error.rows());
+            layer.backward(error, error_prev);
+            backward_from<I - 1>(error_prev, error_input);
+        }
+    }
+
+    template <std::size_t I> Tensor forward_allocating(Tensor output)
+    {
+        if constexpr (I == size)
+        {
+            return output;
+        }
+        else
+        {
+            return forward_allocating<I + 1>(std::get<I>(layers).forward(output));
+        }
+    }
+
+    template <std::size_t I> Tensor backward_allocating(const Tensor &error_tensor)
+    {
+        Tensor error_prev = std::get<I>(layers).backward(error_tensor);
+        if constexpr (I == 0)
+        {
+            return error_prev;
+        }
+        else
+        {
+            return backward_allocating<I - 1>(error_prev);
+        }
+    }
+};
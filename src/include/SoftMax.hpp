@@ -2,17 +2,29 @@
 
 #include "BaseLayer.hpp"
 #include "Eigen/Dense"
+#include <algorithm>
+#include <optional>
 
 using Tensor = Eigen::MatrixXd;
 
-class SoftMax final : public BaseLayer
+template <typename Scalar = double>
+class BasicSoftMax final : public BasicBaseLayer<Scalar>
 {
+public:
+    using Tensor = BasicTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
 private:
     Tensor input_tensor_cache;
+    // Output of the last buffer based forward pass and per-sample workspace
+    std::optional<ConstTensorRef> output_ref;
+    Vector row_workspace;
 
 public:
-    SoftMax() : BaseLayer() {}
-    ~SoftMax() {}
+    BasicSoftMax() : BasicBaseLayer<Scalar>() {}
+    ~BasicSoftMax() {}
 
     /**
      * @author Lam Tran
@@ -52,4 +64,51 @@ public:
         // Perform the final element-wise multiplication with input_tensor_cache y_hat
         return input_tensor_cache.array() * adjusted_error.array();
     }
-};
\ No newline at end of file
+
+    /**
+     * @brief Softmax into a caller-provided buffer, shifted by the row maximum for numerical stability
+     *
+     * @param input Input tensor from the predecessor layer
+     * @param output
+     */
+    void forward(const ConstTensorRef &input, TensorRef output) override
+    {
+        if (row_workspace.size() < input.rows())
+        {
+            reserve(input.rows());
+        }
+
+        auto row_max = row_workspace.head(input.rows());
+        row_max = input.rowwise().maxCoeff();
+        // Shift and exp as separate passes: exp() of the broadcast expression does not vectorize
+        output = input.colwise() - row_max;
+        output = output.array().exp();
+
+        auto row_inverse_sum = row_workspace.head(input.rows());
+        row_inverse_sum = output.rowwise().sum().cwiseInverse();
+        output.array().colwise() *= row_inverse_sum.array();
+
+        output_ref.emplace(output);
+    }
+
+    /**
+     * @brief Softmax Jacobian-vector product y_hat * (e - sum(e * y_hat)) into a caller-provided buffer
+     *
+     * @param error Error tensor from the successor layer
+     * @param error_prev
+     */
+    void backward(const ConstTensorRef &error, TensorRef error_prev) override
+    {
+        const ConstTensorRef &output = *output_ref;
+        auto weighted_sum_error = row_workspace.head(error.rows());
+        weighted_sum_error = error.cwiseProduct(output).rowwise().sum();
+        error_prev = output.array() * (error.colwise() - weighted_sum_error).array();
+    }
+
+    void reserve(Eigen::Index max_batch_size) override
+    {
+        row_workspace.resize(std::max(max_batch_size, row_workspace.size()));
+    }
+};
+
+using SoftMax = BasicSoftMax<>;
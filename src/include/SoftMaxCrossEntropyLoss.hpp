@@ -0,0 +1,132 @@
+#pragma once
+
+#include "BaseLayer.hpp"
+#include "Eigen/Dense"
+#include <algorithm>
+#include <optional>
+
+using Tensor = Eigen::MatrixXd;
+
+/**
+ * @brief SoftMax and CrossEntropyLoss fused into one output head that works on the logits. The loss is computed
+ * @brief via log-sum-exp, lse - x[label], so it needs neither the EPSILON of CrossEntropyLoss nor a log of the
+ * @brief probabilities, and the error tensor for the predecessor layer is simply p - y: no division by p and no
+ * @brief SoftMax Jacobian product. Labels are expected to be one-hot (or at least to sum to 1 per sample).
+ */
+template <typename Scalar = double>
+class BasicSoftMaxCrossEntropyLoss final : public BasicBaseLayer<Scalar>
+{
+public:
+    using Tensor = BasicTensor<Scalar>;
+    using TensorRef = BasicTensorRef<Scalar>;
+    using ConstTensorRef = BasicConstTensorRef<Scalar>;
+    using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
+private:
+    // Owned probabilities of the allocating forward(); the buffer based one only keeps a view in probabilities_ref
+    Tensor probabilities_cache;
+    std::optional<ConstTensorRef> probabilities_ref;
+    // Per-sample maximum of the logits and inverse sum of the shifted exponentials of the last softmax
+    Vector row_max_workspace;
+    Vector row_inverse_sum_workspace;
+
+public:
+    BasicSoftMaxCrossEntropyLoss() : BasicBaseLayer<Scalar>() {}
+    ~BasicSoftMaxCrossEntropyLoss() {}
+
+    /**
+     * @brief Probabilities for the logits, e.g. for inference
+     * @param logits_tensor Logits from the predecessor layer
+     * @return Tensor
+     */
+    Tensor forward(const Tensor &logits_tensor) override
+    {
+        probabilities_cache.resize(logits_tensor.rows(), logits_tensor.cols());
+        forward(logits_tensor, probabilities_cache);
+        return probabilities_cache;
+    }
+
+    /**
+     * @brief Probabilities for the logits into a caller-provided buffer
+     * @param logits Logits from the predecessor layer
+     * @param probabilities
+     */
+    void forward(const ConstTensorRef &logits, TensorRef probabilities) override
+    {
+        softmax(logits, probabilities);
+    }
+
+    /**
+     * @brief Softmax of the logits into probabilities and the summed cross entropy loss against the labels,
+     * @brief sum over the samples of sum(y) * lse - y . x with lse = max + log(sum(exp(x - max))).
+     * @brief The probabilities are kept as a view for backward(), so they must stay alive until then.
+     * @param logits Logits from the predecessor layer
+     * @param label_tensor
+     * @param probabilities Batch x classes, written by the layer
+     * @return double
+     */
+    double computed_loss(const ConstTensorRef &logits, const ConstTensorRef &label_tensor, TensorRef probabilities)
+    {
+        softmax(logits, probabilities);
+
+        const Eigen::Index batch_size = logits.rows();
+        const auto lse =
+            row_max_workspace.head(batch_size).array() - row_inverse_sum_workspace.head(batch_size).array().log();
+        return (label_tensor.rowwise().sum().array() * lse).sum() - label_tensor.cwiseProduct(logits).sum();
+    }
+
+    /**
+     * @brief Error tensor with respect to the logits, p - y
+     * @param label_tensor
+     * @return Tensor
+     */
+    Tensor backward(const Tensor &label_tensor) override
+    {
+        return *probabilities_ref - label_tensor;
+    }
+
+    /**
+     * @brief Error tensor with respect to the logits, p - y, into a caller-provided buffer
+     * @param label_tensor
+     * @param error_tensor
+     */
+    void backward(const ConstTensorRef &label_tensor, TensorRef error_tensor) override
+    {
+        error_tensor = *probabilities_ref - label_tensor;
+    }
+
+    void reserve(Eigen::Index max_batch_size) override
+    {
+        row_max_workspace.resize(std::max(max_batch_size, row_max_workspace.size()));
+        row_inverse_sum_workspace.resize(std::max(max_batch_size, row_inverse_sum_workspace.size()));
+    }
+
+private:
+    /**
+     * @brief Softmax shifted by the row maximum; keeps the row maxima and the inverse row sums of the shifted
+     * @brief exponentials for computed_loss()
+     * @param logits
+     * @param probabilities
+     */
+    void softmax(const ConstTensorRef &logits, TensorRef probabilities)
+    {
+        if (row_max_workspace.size() < logits.rows())
+        {
+            reserve(logits.rows());
+        }
+
+        auto row_max = row_max_workspace.head(logits.rows());
+        row_max = logits.rowwise().maxCoeff();
+        // Shift and exp as separate passes: exp() of the broadcast expression does not vectorize
+        probabilities = logits.colwise() - row_max;
+        probabilities = probabilities.array().exp();
+
+        auto row_inverse_sum = row_inverse_sum_workspace.head(logits.rows());
+        row_inverse_sum = probabilities.rowwise().sum().cwiseInverse();
+        probabilities.array().colwise() *= row_inverse_sum.array();
+
+        probabilities_ref.emplace(probabilities);
+    }
+};
+
+using SoftMaxCrossEntropyLoss = BasicSoftMaxCrossEntropyLoss<>;
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Shared pieces of the kernel benchmark (bench_kernels). The matvec.hpp kernels and the Eigen layers each define a
+// global Tensor type, so they are benchmarked in separate translation units that both report through this header.
+
+/**
+ * @brief One benchmark result. Kernels are identified by name plus the batch and hidden size of the grid point
+ * (0 where a dimension does not apply).
+ */
+struct BenchResult
+{
+    std::string name;
+    long batch;
+    long hidden;
+    double ns_per_op;
+    double gflops;
+    double gbps;
+
+    std::string key() const
+    {
+        return name + "/" + std::to_string(batch) + "/" + std::to_string(hidden);
+    }
+};
+
+/**
+ * @brief Times a callable and returns the best-of-five average wall time per call in nanoseconds.
+ * The number of calls per measurement is calibrated so that one measurement takes roughly 20 ms.
+ *
+ * @param {fn} The callable to benchmark.
+ *
+ * @return Nanoseconds per call.
+ */
+template <typename Fn>
+inline double time_ns(Fn&& fn)
+{
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+    fn(); // warm-up and calibration
+    const double once = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    const int reps = static_cast<int>(std::clamp(20e6 / std::max(once, 1.0), 1.0, 1e6));
+
+    double best = 1e300;
+    for (int trial = 0; trial < 5; trial++)
+    {
+        start = Clock::now();
+        for (int r = 0; r < reps; r++)
+        {
+            fn();
+        }
+        best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count() / reps);
+    }
+    return best;
+}
+
+/**
+ * @brief Times a kernel and derives throughput from its nominal work.
+ *
+ * @param {name} Kernel name.
+ * @param {batch} Batch size of the grid point, 0 if not applicable.
+ * @param {hidden} Hidden size of the grid point, 0 if not applicable.
+ * @param {flops} Floating point operations per call.
+ * @param {bytes} Minimum memory traffic per call (operands read once, results written once).
+ * @param {fn} The kernel call.
+ *
+ * @return The benchmark result.
+ */
+template <typename Fn>
+inline BenchResult measure(const std::string& name, long batch, long hidden, double flops, double bytes, Fn&& fn)
+{
+    const double ns = time_ns(fn);
+    BenchResult result{name, batch, hidden, ns, flops / ns, bytes / ns};
+    std::fprintf(stderr, "%-22s batch %5ld hidden %5ld %14.1f ns %9.2f GF/s %9.2f GB/s\n", name.c_str(), batch,
+                 hidden, result.ns_per_op, result.gflops, result.gbps);
+    return result;
+}
+
+/**
+ * @brief Benchmarks the matvec.hpp kernels over the hidden size grid (see bench_kernels_matvec.cpp).
+ *
+ * @param {hidden_sizes} Matrix row counts; the column count is the MNIST input size.
+ *
+ * @return The benchmark results.
+ */
+std::vector<BenchResult> run_matvec_benchmarks(const std::vector<long>& hidden_sizes);
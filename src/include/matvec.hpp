@@ -1,6 +1,10 @@
 #pragma once
 
+#include "Intrinsics.hpp"
 #include "tensor.hpp"
+#include "tensor_algorithms.hpp"
+
+#include <type_traits>
 
 template< typename ComponentType >
 class Vector
@@ -32,6 +36,15 @@ public:
     // Reference to internal tensor.
     Tensor< ComponentType >& tensor();
 
+    // Const reference to internal tensor.
+    const Tensor< ComponentType >& tensor() const;
+
+    // Pointer to the contiguous (row-major) element storage.
+    const ComponentType* data() const;
+
+    // Mutable pointer to the element storage.
+    ComponentType* data();
+
 private:
     Tensor< ComponentType > tensor_;
 };
@@ -69,6 +82,15 @@ public:
     // Reference to internal tensor.
     Tensor< ComponentType >& tensor();
 
+    // Const reference to internal tensor.
+    const Tensor< ComponentType >& tensor() const;
+
+    // Pointer to the contiguous (row-major) element storage.
+    const ComponentType* data() const;
+
+    // Mutable pointer to the element storage.
+    ComponentType* data();
+
 private:
     Tensor< ComponentType > tensor_;
 };
@@ -124,6 +146,24 @@ Tensor< ComponentType >& Vector< ComponentType >::tensor()
     return tensor_;
 }
 
+template< typename ComponentType >
+const Tensor< ComponentType >& Vector< ComponentType >::tensor() const
+{
+    return tensor_;
+}
+
+template< typename ComponentType >
+const ComponentType* Vector< ComponentType >::data() const
+{
+    return tensor_.data();
+}
+
+template< typename ComponentType >
+ComponentType* Vector< ComponentType >::data()
+{
+    return tensor_.data();
+}
+
 template< typename ComponentType >
 Matrix< ComponentType >::Matrix(size_t rows, size_t cols)
     : tensor_({rows, cols})
@@ -180,10 +220,29 @@ Tensor< ComponentType >& Matrix< ComponentType >::tensor()
     return tensor_;
 }
 
+template< typename ComponentType >
+const Tensor< ComponentType >& Matrix< ComponentType >::tensor() const
+{
+    return tensor_;
+}
 
-// Performs a matrix-vector multiplication.
 template< typename ComponentType >
-Vector< ComponentType > matvec(const Matrix< ComponentType >& mat, const Vector< ComponentType >& vec)
+const ComponentType* Matrix< ComponentType >::data() const
+{
+    return tensor_.data();
+}
+
+template< typename ComponentType >
+ComponentType* Matrix< ComponentType >::data()
+{
+    return tensor_.data();
+}
+
+
+// Reference matrix-vector multiplication through the element access functions.
+// Kept to validate and benchmark matvec() against.
+template< typename ComponentType >
+Vector< ComponentType > matvecNaive(const Matrix< ComponentType >& mat, const Vector< ComponentType >& vec)
 {
 
     if (mat.cols() != vec.size())
@@ -203,3 +262,524 @@ Vector< ComponentType > matvec(const Matrix< ComponentType >& mat, const Vector<
 
     return out;
 }
+
+// Minimum number of matrix elements before matvec() splits the rows across threads.
+inline constexpr size_t MATVEC_PARALLEL_THRESHOLD = 1 << 16;
+
+namespace detail
+{
+
+// Dot product of two contiguous arrays of length n.
+template< typename ComponentType >
+inline ComponentType dot(const ComponentType* a, const ComponentType* b, size_t n)
+{
+    ComponentType acc = 0;
+#pragma omp simd reduction(+ : acc)
+    for (size_t i = 0; i < n; i++)
+    {
+        acc += a[i] * b[i];
+    }
+    return acc;
+}
+
+#if defined(X86_KERNELS)
+
+// The AVX-512 and AVX2 kernels are compiled for their instruction set whatever -march says, and only called once
+// dotRowsKernel() found it on the CPU the program runs on.
+
+__attribute__((target("avx512f"))) inline double dotAvx512(const double* a, const double* b, size_t n)
+{
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    __m512d acc2 = _mm512_setzero_pd();
+    __m512d acc3 = _mm512_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+        acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), acc1);
+        acc2 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 16), _mm512_loadu_pd(b + i + 16), acc2);
+        acc3 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 24), _mm512_loadu_pd(b + i + 24), acc3);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), acc0);
+    }
+    if (i < n)
+    {
+        const __mmask8 tail = static_cast< __mmask8 >((1u << (n - i)) - 1);
+        acc1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(tail, a + i), _mm512_maskz_loadu_pd(tail, b + i), acc1);
+    }
+
+    return _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3)));
+}
+
+__attribute__((target("avx512f"))) inline float dotAvx512(const float* a, const float* b, size_t n)
+{
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps();
+    __m512 acc3 = _mm512_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 32), _mm512_loadu_ps(b + i + 32), acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 48), _mm512_loadu_ps(b + i + 48), acc3);
+    }
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    }
+    if (i < n)
+    {
+        const __mmask16 tail = static_cast< __mmask16 >((1u << (n - i)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a + i), _mm512_maskz_loadu_ps(tail, b + i), acc1);
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+}
+
+__attribute__((target("avx2,fma"))) inline double dotAvx2(const double* a, const double* b, size_t n)
+{
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd();
+    __m256d acc3 = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), acc1);
+        acc2 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 8), _mm256_loadu_pd(b + i + 8), acc2);
+        acc3 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 12), _mm256_loadu_pd(b + i + 12), acc3);
+    }
+    for (; i + 4 <= n; i += 4)
+    {
+        acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), acc0);
+    }
+    if (i < n)
+    {
+        const __m256i tail = _mm256_cmpgt_epi64(_mm256_set1_epi64x(static_cast< long long >(n - i)),
+                                                _mm256_setr_epi64x(0, 1, 2, 3));
+        acc1 = _mm256_fmadd_pd(_mm256_maskload_pd(a + i, tail), _mm256_maskload_pd(b + i, tail), acc1);
+    }
+
+    const __m256d acc = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+__attribute__((target("avx2,fma"))) inline float dotAvx2(const float* a, const float* b, size_t n)
+{
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    if (i < n)
+    {
+        const __m256i tail = _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast< int >(n - i)),
+                                                _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        acc1 = _mm256_fmadd_ps(_mm256_maskload_ps(a + i, tail), _mm256_maskload_ps(b + i, tail), acc1);
+    }
+
+    const __m256 acc = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+    __m128 quad = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    return _mm_cvtss_f32(_mm_add_ss(quad, _mm_movehdup_ps(quad)));
+}
+
+#endif
+
+// Writes the dot products of the rows [begin, end) of the row-major matrix a with x to y. A nonzero Cols fixes the
+// row length at compile time, so the dot products can be unrolled and their tails resolved statically.
+template< size_t Cols, typename ComponentType >
+void dotRows(const ComponentType* a, const ComponentType* x, ComponentType* y, size_t begin, size_t end, size_t cols)
+{
+    const size_t n = Cols != 0 ? Cols : cols;
+    for (size_t row = begin; row < end; row++)
+    {
+        y[row] = dot(a + row * n, x, n);
+    }
+}
+
+#if defined(X86_KERNELS)
+
+template< size_t Cols, typename ComponentType >
+__attribute__((target("avx512f"))) void dotRowsAvx512(const ComponentType* a, const ComponentType* x,
+                                                      ComponentType* y, size_t begin, size_t end, size_t cols)
+{
+    const size_t n = Cols != 0 ? Cols : cols;
+    for (size_t row = begin; row < end; row++)
+    {
+        y[row] = dotAvx512(a + row * n, x, n);
+    }
+}
+
+template< size_t Cols, typename ComponentType >
+__attribute__((target("avx2,fma"))) void dotRowsAvx2(const ComponentType* a, const ComponentType* x,
+                                                     ComponentType* y, size_t begin, size_t end, size_t cols)
+{
+    const size_t n = Cols != 0 ? Cols : cols;
+    for (size_t row = begin; row < end; row++)
+    {
+        y[row] = dotAvx2(a + row * n, x, n);
+    }
+}
+
+#endif
+
+template< typename ComponentType >
+using DotRowsKernel = void (*)(const ComponentType*, const ComponentType*, ComponentType*, size_t, size_t, size_t);
+
+// The widest dotRows() variant the CPU supports. Only double and float have hand-written kernels.
+template< size_t Cols, typename ComponentType >
+DotRowsKernel< ComponentType > dotRowsKernel()
+{
+#if defined(X86_KERNELS)
+    if constexpr (std::is_same_v< ComponentType, double > || std::is_same_v< ComponentType, float >)
+    {
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            return dotRowsAvx512< Cols, ComponentType >;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return dotRowsAvx2< Cols, ComponentType >;
+        }
+    }
+#endif
+    return dotRows< Cols, ComponentType >;
+}
+
+} // namespace detail
+
+
+// Performs a matrix-vector multiplication.
+// Works on the raw row-major storage: every output element is a vectorized dot product of one matrix row with the
+// vector, and the rows are distributed across OpenMP threads for matrices with at least MATVEC_PARALLEL_THRESHOLD
+// elements.
+template< typename ComponentType >
+Vector< ComponentType > matvec(const Matrix< ComponentType >& mat, const Vector< ComponentType >& vec)
+{
+
+    if (mat.cols() != vec.size())
+    {
+        std::exit(1);
+    }
+
+    const size_t rows = mat.rows();
+    const size_t cols = mat.cols();
+
+    Vector< ComponentType > out(rows);
+
+    const ComponentType* a = mat.data();
+    const ComponentType* x = vec.data();
+    ComponentType* y = out.data();
+
+    const auto kernel = detail::dotRowsKernel< 0, ComponentType >();
+#pragma omp parallel if (rows * cols >= MATVEC_PARALLEL_THRESHOLD)
+    {
+        auto [begin, end] = detail::threadChunk(rows);
+        kernel(a, x, y, begin, end, cols);
+    }
+
+    return out;
+}
+
+// Performs a matrix-vector multiplication for a shape known at compile time, e.g. a layer of a fixed topology.
+// Same kernel as matvec(), but the constant row length lets the compiler unroll the dot products and resolve their
+// tails statically, and the threading decision is made at compile time.
+template< size_t Rows, size_t Cols, typename ComponentType >
+Vector< ComponentType > matvecFixed(const Matrix< ComponentType >& mat, const Vector< ComponentType >& vec)
+{
+
+    if (mat.rows() != Rows || mat.cols() != Cols || vec.size() != Cols)
+    {
+        std::exit(1);
+    }
+
+    Vector< ComponentType > out(Rows);
+
+    const ComponentType* a = mat.data();
+    const ComponentType* x = vec.data();
+    ComponentType* y = out.data();
+
+    const auto kernel = detail::dotRowsKernel< Cols, ComponentType >();
+    if constexpr (Rows * Cols >= MATVEC_PARALLEL_THRESHOLD)
+    {
+#pragma omp parallel
+        {
+            auto [begin, end] = detail::threadChunk(Rows);
+            kernel(a, x, y, begin, end, Cols);
+        }
+    }
+    else
+    {
+        kernel(a, x, y, 0, Rows, Cols);
+    }
+
+    return out;
+}
+
+namespace detail
+{
+
+// y[0:n] += alpha * x[0:n]
+template< typename ComponentType >
+inline void axpy(size_t n, ComponentType alpha, const ComponentType* x, ComponentType* y)
+{
+#pragma omp simd
+    for (size_t i = 0; i < n; i++)
+    {
+        y[i] += alpha * x[i];
+    }
+}
+
+} // namespace detail
+
+
+// Performs a transposed matrix-vector multiplication mat^T * vec without materializing the transpose.
+// The row-major matrix is streamed row by row and each row is accumulated into the result scaled by the matching
+// vector element; threads own disjoint column ranges, so no reduction is needed.
+template< typename ComponentType >
+Vector< ComponentType > matvecTransposed(const Matrix< ComponentType >& mat, const Vector< ComponentType >& vec)
+{
+
+    if (mat.rows() != vec.size())
+    {
+        std::exit(1);
+    }
+
+    const size_t rows = mat.rows();
+    const size_t cols = mat.cols();
+
+    Vector< ComponentType > out(cols, ComponentType(0));
+
+    const ComponentType* a = mat.data();
+    const ComponentType* x = vec.data();
+    ComponentType* y = out.data();
+
+#pragma omp parallel if (rows * cols >= MATVEC_PARALLEL_THRESHOLD)
+    {
+        auto [begin, end] = detail::threadChunk(cols);
+        for (size_t row = 0; row < rows; row++)
+        {
+            detail::axpy(end - begin, x[row], a + row * cols + begin, y + begin);
+        }
+    }
+
+    return out;
+}
+
+// Rank-1 update mat += alpha * x * y^T (BLAS GER), e.g. the weight gradient of a single sample.
+// Updates the matrix in place row by row, splitting the rows across threads for large matrices.
+template< typename ComponentType >
+void ger(ComponentType alpha, const Vector< ComponentType >& x, const Vector< ComponentType >& y,
+         Matrix< ComponentType >& mat)
+{
+
+    if (mat.rows() != x.size() || mat.cols() != y.size())
+    {
+        std::exit(1);
+    }
+
+    const size_t rows = mat.rows();
+    const size_t cols = mat.cols();
+
+    const ComponentType* xs = x.data();
+    const ComponentType* ys = y.data();
+    ComponentType* a = mat.data();
+
+#pragma omp parallel for schedule(static) if (rows * cols >= MATVEC_PARALLEL_THRESHOLD)
+    for (size_t row = 0; row < rows; row++)
+    {
+        detail::axpy(cols, alpha * xs[row], ys, a + row * cols);
+    }
+}
+
+namespace detail
+{
+
+// Register block of the matmul() micro-kernel: MR rows of A times NR columns of B, sized so that the MR x NR
+// accumulators fill most of the vector register file (24 of 32 zmm registers, or 12 of 16 ymm registers).
+#if defined(__AVX512F__)
+inline constexpr size_t kGemmVectorBytes = 64;
+inline constexpr size_t kGemmVectorsPerRow = 4;
+#else
+inline constexpr size_t kGemmVectorBytes = 32;
+inline constexpr size_t kGemmVectorsPerRow = 2;
+#endif
+template< typename ComponentType >
+inline constexpr size_t kGemmMR = 6;
+template< typename ComponentType >
+inline constexpr size_t kGemmNR = kGemmVectorsPerRow * kGemmVectorBytes / sizeof(ComponentType);
+
+// Cache blocks: a KC x NR panel of B stays in L1, an MC x KC block of A in L2 and a KC x NC block of B in L3.
+inline constexpr size_t kGemmMC = 96;
+inline constexpr size_t kGemmKC = 256;
+inline constexpr size_t kGemmNC = 2048;
+
+// Copies the mc x kc block of A starting at a (leading dimension lda) into micro-panels of MR rows, each stored
+// column by column, zero-padding the last panel.
+template< typename ComponentType >
+void packA(const ComponentType* a, size_t lda, size_t mc, size_t kc, ComponentType* packed)
+{
+    constexpr size_t MR = kGemmMR< ComponentType >;
+    for (size_t i0 = 0; i0 < mc; i0 += MR)
+    {
+        const size_t mr = std::min(MR, mc - i0);
+        for (size_t p = 0; p < kc; p++)
+        {
+            for (size_t i = 0; i < MR; i++)
+            {
+                packed[p * MR + i] = i < mr ? a[(i0 + i) * lda + p] : ComponentType(0);
+            }
+        }
+        packed += kc * MR;
+    }
+}
+
+// Copies the kc x nc block of B starting at b (leading dimension ldb) into micro-panels of NR columns, each stored
+// row by row, zero-padding the last panel.
+template< typename ComponentType >
+void packB(const ComponentType* b, size_t ldb, size_t kc, size_t nc, ComponentType* packed)
+{
+    constexpr size_t NR = kGemmNR< ComponentType >;
+    for (size_t j0 = 0; j0 < nc; j0 += NR)
+    {
+        const size_t nr = std::min(NR, nc - j0);
+        ComponentType* panel = packed + (j0 / NR) * kc * NR;
+        for (size_t p = 0; p < kc; p++)
+        {
+            for (size_t j = 0; j < NR; j++)
+            {
+                panel[p * NR + j] = j < nr ? b[p * ldb + j0 + j] : ComponentType(0);
+            }
+        }
+    }
+}
+
+// C[0:mr, 0:nr] += packed A micro-panel * packed B micro-panel over kc. The MR x NR accumulator block is kept in
+// registers; only the valid mr x nr part is written back.
+template< typename ComponentType >
+inline void gemmMicroKernel(size_t kc, const ComponentType* ap, const ComponentType* bp, ComponentType* c, size_t ldc,
+                            size_t mr, size_t nr)
+{
+    constexpr size_t MR = kGemmMR< ComponentType >;
+    constexpr size_t NR = kGemmNR< ComponentType >;
+
+    ComponentType acc[MR][NR] = {};
+
+    for (size_t p = 0; p < kc; p++)
+    {
+        const ComponentType* bRow = bp + p * NR;
+        for (size_t i = 0; i < MR; i++)
+        {
+            const ComponentType aik = ap[p * MR + i];
+#pragma omp simd
+            for (size_t j = 0; j < NR; j++)
+            {
+                acc[i][j] += aik * bRow[j];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < mr; i++)
+    {
+        for (size_t j = 0; j < nr; j++)
+        {
+            c[i * ldc + j] += acc[i][j];
+        }
+    }
+}
+
+} // namespace detail
+
+
+// Performs a matrix-matrix multiplication.
+// Blocked for the cache hierarchy: B is packed once per KC x NC block and shared by all threads, every thread packs
+// its own MC x KC blocks of A, and a register-blocked micro-kernel computes MR x NR tiles of the result. The MC
+// blocks are distributed across OpenMP threads when the product has at least MATVEC_PARALLEL_THRESHOLD multiply-adds.
+template< typename ComponentType >
+Matrix< ComponentType > matmul(const Matrix< ComponentType >& lhs, const Matrix< ComponentType >& rhs)
+{
+
+    if (lhs.cols() != rhs.rows())
+    {
+        std::exit(1);
+    }
+
+    constexpr size_t MR = detail::kGemmMR< ComponentType >;
+    constexpr size_t NR = detail::kGemmNR< ComponentType >;
+    constexpr size_t MC = detail::kGemmMC;
+    constexpr size_t KC = detail::kGemmKC;
+    constexpr size_t NC = detail::kGemmNC;
+
+    const size_t m = lhs.rows();
+    const size_t k = lhs.cols();
+    const size_t n = rhs.cols();
+
+    Matrix< ComponentType > out(m, n, ComponentType(0));
+
+    const ComponentType* a = lhs.data();
+    const ComponentType* b = rhs.data();
+    ComponentType* c = out.data();
+
+    // B panels are padded to full NR columns
+    std::vector< ComponentType > packedB(KC * ((std::min(NC, n) + NR - 1) / NR) * NR);
+
+#pragma omp parallel if (m * n * k >= MATVEC_PARALLEL_THRESHOLD)
+    {
+        std::vector< ComponentType > packedA(((MC + MR - 1) / MR) * MR * KC);
+
+        for (size_t jc = 0; jc < n; jc += NC)
+        {
+            const size_t nc = std::min(NC, n - jc);
+
+            for (size_t pc = 0; pc < k; pc += KC)
+            {
+                const size_t kc = std::min(KC, k - pc);
+
+#pragma omp single
+                detail::packB(b + pc * n + jc, n, kc, nc, packedB.data());
+
+#pragma omp for schedule(dynamic)
+                for (size_t ic = 0; ic < m; ic += MC)
+                {
+                    const size_t mc = std::min(MC, m - ic);
+                    detail::packA(a + ic * k + pc, k, mc, kc, packedA.data());
+
+                    for (size_t jr = 0; jr < nc; jr += NR)
+                    {
+                        for (size_t ir = 0; ir < mc; ir += MR)
+                        {
+                            detail::gemmMicroKernel(kc, packedA.data() + ir * kc, packedB.data() + jr * kc,
+                                                    c + (ic + ir) * n + jc + jr, n, std::min(MR, mc - ir),
+                                                    std::min(NR, nc - jr));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return out;
+}
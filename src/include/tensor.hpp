@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
@@ -68,6 +69,36 @@ ScalarType stringToScalar(const std::string& str)
 template< class T >
 concept Arithmetic = std::is_arithmetic_v< T >;
 
+// Non-owning view onto a contiguous row-major buffer, e.g. a Tensor or raw file data.
+// Use TensorView< const ComponentType > for read-only access.
+template< Arithmetic ComponentType >
+class TensorView
+{
+public:
+    // Constructs a view with the given shape onto the buffer starting at data.
+    TensorView(ComponentType* data, const std::vector< size_t >& shape);
+
+    // Returns the rank of the viewed tensor.
+    [[nodiscard]] size_t rank() const;
+
+    // Returns the shape of the viewed tensor.
+    [[nodiscard]] std::vector< size_t > shape() const;
+
+    // Returns the number of elements of the viewed tensor.
+    [[nodiscard]] size_t numElements() const;
+
+    // Pointer to the first element.
+    [[nodiscard]] ComponentType* data() const;
+
+    // Element access function
+    ComponentType&
+    operator()(const std::vector< size_t >& idx) const;
+
+private:
+    ComponentType* data_;
+    std::vector< size_t > shape_;
+};
+
 template< Arithmetic ComponentType >
 class Tensor
 {
@@ -84,78 +115,160 @@ public:
     // Copy-constructor.
     Tensor(const Tensor< ComponentType >& other);
 
-    // Move-constructor.
+    // Move-constructor. Leaves other empty: rank 0, no elements and no buffer, so data() returns nullptr and
+    // element access and views assert. An empty tensor can be assigned to or destroyed.
     Tensor(Tensor< ComponentType >&& other) noexcept;
 
     // Copy-assignment
     Tensor&
     operator=(const Tensor< ComponentType >& other);
 
-    // Move-assignment
+    // Move-assignment. Leaves other empty, like the move-constructor.
     Tensor&
     operator=(Tensor< ComponentType >&& other) noexcept;
 
     // Destructor
     ~Tensor() = default;
 
+    // Returns a tensor sharing this tensor's buffer instead of copying it.
+    // The buffer is copied lazily by whichever tensor is mutated first (copy-on-write).
+    // share() invalidates every mutable reference, pointer and view obtained from this tensor before the call:
+    // writes through them would reach the shared buffer, so obtain them again after sharing.
+    [[nodiscard]] Tensor share() const;
+
+    // Returns true if the buffer is currently shared with another tensor.
+    [[nodiscard]] bool isShared() const;
+
     // Returns the rank of the tensor.
     [[nodiscard]] size_t rank() const;
 
     // Returns the shape of the tensor.
     [[nodiscard]] std::vector< size_t > shape() const;
 
-    // Returns the number of elements of this tensor.
+    // Returns the number of elements of this tensor (0 if it is empty).
     [[nodiscard]] size_t numElements() const;
 
     // Element access function
     const ComponentType&
     operator()(const std::vector< size_t >& idx) const;
 
-    // Element mutation function
+    // Element mutation function (detaches from a shared buffer first).
     ComponentType&
     operator()(const std::vector< size_t >& idx);
 
+    // Pointer to the contiguous row-major element storage (nullptr if the tensor is empty).
+    [[nodiscard]] const ComponentType* data() const;
+
+    // Mutable pointer to the element storage (detaches from a shared buffer first, nullptr if the tensor is empty).
+    [[nodiscard]] ComponentType* data();
+
+    // Read-only view onto the element storage.
+    [[nodiscard]] TensorView< const ComponentType > view() const;
+
+    // Mutable view onto the element storage (detaches from a shared buffer first).
+    [[nodiscard]] TensorView< ComponentType > view();
+
 private:
 
+    using Buffer = std::vector< ComponentType >;
+
+    // Gives this tensor its own copy of the buffer if it is shared.
+    void detach();
+
     std::vector< size_t > shape_;
-    std::vector< ComponentType > data_;
+    std::shared_ptr< Buffer > data_;
 
 };
 
 
+template< Arithmetic ComponentType >
+TensorView< ComponentType >::TensorView(ComponentType* data, const std::vector< size_t >& shape)
+    : data_(data), shape_(shape)
+{
+}
+
+template< Arithmetic ComponentType >
+size_t
+TensorView< ComponentType >::rank() const
+{
+    return shape_.size();
+}
+
+template< Arithmetic ComponentType >
+std::vector< size_t >
+TensorView< ComponentType >::shape() const
+{
+    return shape_;
+}
+
+template< Arithmetic ComponentType >
+size_t
+TensorView< ComponentType >::numElements() const
+{
+    return numTensorElements(shape_);
+}
+
+template< Arithmetic ComponentType >
+ComponentType*
+TensorView< ComponentType >::data() const
+{
+    return data_;
+}
+
+template< Arithmetic ComponentType >
+ComponentType&
+TensorView< ComponentType >::operator()(const std::vector< size_t >& idx) const
+{
+    assert(idx.size() == rank());
+    return data_[flatIdx(shape_, idx)];
+}
+
+
 template< Arithmetic ComponentType >
 Tensor< ComponentType >::Tensor()
-    : shape_(0), data_(1, 0)
+    : shape_(0), data_(std::make_shared< Buffer >(1, 0))
 {
 }
 
 template< Arithmetic ComponentType >
 Tensor< ComponentType >::Tensor(const std::vector< size_t >& shape)
-    : shape_(shape), data_(numTensorElements(shape), 0)
+    : shape_(shape), data_(std::make_shared< Buffer >(numTensorElements(shape), 0))
 {
 }
 
 template< Arithmetic ComponentType >
 Tensor< ComponentType >::Tensor(const std::vector< size_t >& shape, const ComponentType& fillValue)
-    : shape_(shape), data_(numTensorElements(shape), fillValue)
+    : shape_(shape), data_(std::make_shared< Buffer >(numTensorElements(shape), fillValue))
 {
 }
 
-// Copy-assignment
+// Copy-constructor (deep copy, use share() to avoid it).
 template< Arithmetic ComponentType >
-Tensor< ComponentType >::Tensor(const Tensor< ComponentType >& other) = default;
+Tensor< ComponentType >::Tensor(const Tensor< ComponentType >& other)
+    : shape_(other.shape_), data_(other.data_ ? std::make_shared< Buffer >(*other.data_) : nullptr)
+{
+}
 
 
 // Move-constructor.
 template< Arithmetic ComponentType >
 Tensor< ComponentType >::Tensor(Tensor< ComponentType >&& other) noexcept
-    : shape_(std::exchange(other.shape_, std::vector< size_t >())), data_(std::exchange(other.data_, {0}))
+    : shape_(std::exchange(other.shape_, std::vector< size_t >())),
+      data_(std::move(other.data_))
 {
 }
 
-// Copy-assignment
+// Copy-assignment (deep copy, use share() to avoid it).
 template< Arithmetic ComponentType >
-Tensor< ComponentType >& Tensor< ComponentType >::operator=(const Tensor< ComponentType >& other) = default;
+Tensor< ComponentType >& Tensor< ComponentType >::operator=(const Tensor< ComponentType >& other)
+{
+    if (this != &other)
+    {
+        shape_ = other.shape_;
+        data_ = other.data_ ? std::make_shared< Buffer >(*other.data_) : nullptr;
+    }
+    return *this;
+}
 
 
 // Move-assignment
@@ -164,10 +277,37 @@ Tensor< ComponentType >& Tensor< ComponentType >::operator=(Tensor< ComponentTyp
 
 {
     shape_ = std::exchange(other.shape_, std::vector< size_t >());
-    data_ = std::exchange(other.data_, {0});
+    data_ = std::exchange(other.data_, nullptr);
     return *this;
 }
 
+template< Arithmetic ComponentType >
+Tensor< ComponentType >
+Tensor< ComponentType >::share() const
+{
+    Tensor< ComponentType > shared;
+    shared.shape_ = shape_;
+    shared.data_ = data_;
+    return shared;
+}
+
+template< Arithmetic ComponentType >
+bool
+Tensor< ComponentType >::isShared() const
+{
+    return data_.use_count() > 1;
+}
+
+template< Arithmetic ComponentType >
+void
+Tensor< ComponentType >::detach()
+{
+    if (data_.use_count() > 1)
+    {
+        data_ = std::make_shared< Buffer >(*data_);
+    }
+}
+
 template< Arithmetic ComponentType >
 size_t
 Tensor< ComponentType >::rank() const
@@ -186,7 +326,7 @@ template< Arithmetic ComponentType >
 size_t
 Tensor< ComponentType >::numElements() const
 {
-    return numTensorElements(shape_);
+    return data_ ? numTensorElements(shape_) : 0;
 }
 
 template< Arithmetic ComponentType >
@@ -194,7 +334,8 @@ const ComponentType&
 Tensor< ComponentType >::operator()(const std::vector< size_t >& idx) const
 {
     assert(idx.size() == rank());
-    return data_[flatIdx(shape_, idx)];
+    assert(data_);
+    return (*data_)[flatIdx(shape_, idx)];
 }
 
 template< Arithmetic ComponentType >
@@ -202,69 +343,54 @@ ComponentType&
 Tensor< ComponentType >::operator()(const std::vector< size_t >& idx)
 {
     assert(idx.size() == rank());
-    return data_[flatIdx(shape_, idx)];
+    assert(data_);
+    detach();
+    return (*data_)[flatIdx(shape_, idx)];
 }
 
+template< Arithmetic ComponentType >
+const ComponentType*
+Tensor< ComponentType >::data() const
+{
+    return data_ ? data_->data() : nullptr;
+}
 
-// Returns true if the shapes and all elements of both tensors are equal.
 template< Arithmetic ComponentType >
-bool operator==(const Tensor< ComponentType >& a, const Tensor< ComponentType >& b)
+ComponentType*
+Tensor< ComponentType >::data()
 {
+    detach();
+    return data_ ? data_->data() : nullptr;
+}
 
-    if (a.shape() != b.shape())
-    {
-        return false;
-    }
+template< Arithmetic ComponentType >
+TensorView< const ComponentType >
+Tensor< ComponentType >::view() const
+{
+    assert(data_);
+    return TensorView< const ComponentType >(data(), shape_);
+}
 
-    size_t rank = a.rank();
-    std::vector< size_t > shape = a.shape();
-    size_t numElements = a.numElements();
+template< Arithmetic ComponentType >
+TensorView< ComponentType >
+Tensor< ComponentType >::view()
+{
+    assert(data_);
+    return TensorView< ComponentType >(data(), shape_);
+}
 
-    bool equal = true;
 
-    if (rank == 0)
-    {
-        std::vector< size_t > idx(0);
-        return a(idx) == b(idx);
-    }
-    else if (rank == 1)
-    {
-        for (size_t i = 0; i < shape[0]; i++)
-        {
-            std::vector< size_t > idx(1);
-            idx[0] = i;
-            equal &= a(idx) == b(idx);
-        }
-    }
-    else
+// Returns true if the shapes and all elements of both tensors are equal.
+// Both buffers are row-major, so equal shapes imply an identical element order.
+template< Arithmetic ComponentType >
+bool operator==(const Tensor< ComponentType >& a, const Tensor< ComponentType >& b)
+{
+    if (a.shape() != b.shape() || a.numElements() != b.numElements())
     {
-        size_t cnt = 0;
-        std::vector< size_t > idx(rank, 0);
-
-        while (cnt < numElements)
-        {
-            for (size_t i = 0; i < shape[rank - 1]; i++)
-            {
-                equal &= a(idx) == b(idx);
-                idx[rank - 1]++;
-            }
-
-            idx[rank - 1]++;
-
-            for (size_t i = rank - 1; i > 0; i--)
-            {
-                if (idx[i] >= shape[i])
-                {
-                    idx[i] = 0;
-                    idx[i - 1]++;
-                }
-            }
-
-            cnt += shape[rank - 1];
-        }
+        return false;
     }
 
-    return equal;
+    return std::equal(a.data(), a.data() + a.numElements(), b.data());
 }
 
 // Pretty-prints the tensor to stdout.
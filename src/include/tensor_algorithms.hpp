@@ -0,0 +1,267 @@
+#pragma once
+
+#include "tensor.hpp"
+
+#include <cmath>
+#include <concepts>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Bulk element-wise algorithms over Tensor and TensorView.
+// All of them work on the flat row-major buffer, vectorize the inner loop and split it across OpenMP threads
+// once the buffer is large enough to amortize the thread start-up.
+
+// Minimum number of elements before an algorithm runs multithreaded.
+inline constexpr size_t PARALLEL_THRESHOLD = 1 << 15;
+
+// Anything exposing a contiguous buffer via data() and numElements(), i.e. Tensor and TensorView.
+template< class T >
+concept TensorLike = requires(T& t) {
+    { t.data() };
+    { t.numElements() } -> std::convertible_to< size_t >;
+};
+
+template< TensorLike T >
+using ElementType = std::remove_cvref_t< decltype(*std::declval< T& >().data()) >;
+
+namespace detail
+{
+
+// Number of threads and the [begin, end) chunk of the calling thread for a buffer of n elements.
+inline std::pair< size_t, size_t > threadChunk(size_t n)
+{
+#ifdef _OPENMP
+    const auto thread = static_cast< size_t >(omp_get_thread_num());
+    const auto numThreads = static_cast< size_t >(omp_get_num_threads());
+#else
+    const size_t thread = 0;
+    const size_t numThreads = 1;
+#endif
+    return {n * thread / numThreads, n * (thread + 1) / numThreads};
+}
+
+inline size_t maxThreads()
+{
+#ifdef _OPENMP
+    return static_cast< size_t >(omp_get_max_threads());
+#else
+    return 1;
+#endif
+}
+
+} // namespace detail
+
+
+// Writes op(src[i]) to dst[i]. src and dst must have the same number of elements and may be the same tensor.
+template< TensorLike Src, TensorLike Dst, class UnaryOp >
+void transform(const Src& src, Dst&& dst, UnaryOp op)
+{
+    assert(src.numElements() == dst.numElements());
+
+    const auto* in = src.data();
+    auto* out = dst.data();
+    const auto n = static_cast< long >(src.numElements());
+
+#pragma omp parallel for simd if (static_cast< size_t >(n) >= PARALLEL_THRESHOLD)
+    for (long i = 0; i < n; i++)
+    {
+        out[i] = op(in[i]);
+    }
+}
+
+// Writes op(a[i], b[i]) to dst[i]. All three must have the same number of elements.
+template< TensorLike SrcA, TensorLike SrcB, TensorLike Dst, class BinaryOp >
+void transform(const SrcA& a, const SrcB& b, Dst&& dst, BinaryOp op)
+{
+    assert(a.numElements() == b.numElements() && a.numElements() == dst.numElements());
+
+    const auto* inA = a.data();
+    const auto* inB = b.data();
+    auto* out = dst.data();
+    const auto n = static_cast< long >(a.numElements());
+
+#pragma omp parallel for simd if (static_cast< size_t >(n) >= PARALLEL_THRESHOLD)
+    for (long i = 0; i < n; i++)
+    {
+        out[i] = op(inA[i], inB[i]);
+    }
+}
+
+// Sets every element of dst to value.
+template< TensorLike Dst >
+void fill(Dst&& dst, const ElementType< Dst >& value)
+{
+    auto* out = dst.data();
+    const auto n = static_cast< long >(dst.numElements());
+
+#pragma omp parallel for simd if (static_cast< size_t >(n) >= PARALLEL_THRESHOLD)
+    for (long i = 0; i < n; i++)
+    {
+        out[i] = value;
+    }
+}
+
+// Folds all elements into init with op, i.e. op(...op(op(init, src[0]), src[1])..., src[n-1]).
+// Threads reduce contiguous chunks that are combined in order, so op only has to be associative.
+template< TensorLike Src, class T, class BinaryOp >
+T reduce(const Src& src, T init, BinaryOp op)
+{
+    const auto* in = src.data();
+    const size_t n = src.numElements();
+
+    if (n < PARALLEL_THRESHOLD)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            init = op(init, in[i]);
+        }
+        return init;
+    }
+
+    const size_t numThreads = detail::maxThreads();
+    std::vector< T > partial(numThreads, init);
+    std::vector< char > hasPartial(numThreads, 0);
+
+#pragma omp parallel num_threads(numThreads)
+    {
+        auto [begin, end] = detail::threadChunk(n);
+        if (begin < end)
+        {
+            T acc = static_cast< T >(in[begin]);
+            for (size_t i = begin + 1; i < end; i++)
+            {
+                acc = op(acc, in[i]);
+            }
+#ifdef _OPENMP
+            const auto thread = static_cast< size_t >(omp_get_thread_num());
+#else
+            const size_t thread = 0;
+#endif
+            partial[thread] = acc;
+            hasPartial[thread] = 1;
+        }
+    }
+
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        if (hasPartial[t])
+        {
+            init = op(init, partial[t]);
+        }
+    }
+    return init;
+}
+
+// Sum of all elements. Unlike reduce() this vectorizes, at the price of a non-deterministic summation order.
+template< TensorLike Src >
+ElementType< Src > sum(const Src& src)
+{
+    const auto* in = src.data();
+    const auto n = static_cast< long >(src.numElements());
+    ElementType< Src > acc = 0;
+
+#pragma omp parallel for simd reduction(+ : acc) if (static_cast< size_t >(n) >= PARALLEL_THRESHOLD)
+    for (long i = 0; i < n; i++)
+    {
+        acc += in[i];
+    }
+    return acc;
+}
+
+// Flat index of the largest element; the first one wins on ties (like Eigen's maxCoeff).
+template< TensorLike Src >
+size_t argmax(const Src& src)
+{
+    const auto* in = src.data();
+    const size_t n = src.numElements();
+    assert(n > 0);
+
+    const size_t numThreads = n < PARALLEL_THRESHOLD ? 1 : detail::maxThreads();
+    std::vector< size_t > best(numThreads, n);
+
+#pragma omp parallel num_threads(numThreads)
+    {
+        auto [begin, end] = detail::threadChunk(n);
+        if (begin < end)
+        {
+            size_t idx = begin;
+            for (size_t i = begin + 1; i < end; i++)
+            {
+                if (in[i] > in[idx])
+                {
+                    idx = i;
+                }
+            }
+#ifdef _OPENMP
+            best[static_cast< size_t >(omp_get_thread_num())] = idx;
+#else
+            best[0] = idx;
+#endif
+        }
+    }
+
+    size_t idx = 0;
+    for (size_t candidate : best)
+    {
+        if (candidate < n && in[candidate] > in[idx])
+        {
+            idx = candidate;
+        }
+    }
+    return idx;
+}
+
+// Rescales dst in place to the range [0, 1] (min-max normalization). A constant tensor becomes all zeros.
+template< TensorLike Dst >
+void normalize(Dst&& dst)
+{
+    using T = ElementType< Dst >;
+    static_assert(std::is_floating_point_v< T >, "normalize() requires a floating point tensor");
+
+    auto* data = dst.data();
+    const auto n = static_cast< long >(dst.numElements());
+    T lo = std::numeric_limits< T >::max();
+    T hi = std::numeric_limits< T >::lowest();
+
+#pragma omp parallel for simd reduction(min : lo) reduction(max : hi) if (static_cast< size_t >(n) >= PARALLEL_THRESHOLD)
+    for (long i = 0; i < n; i++)
+    {
+        lo = std::min(lo, data[i]);
+        hi = std::max(hi, data[i]);
+    }
+
+    const T scale = hi > lo ? T(1) / (hi - lo) : T(0);
+
+#pragma omp parallel for simd if (static_cast< size_t >(n) >= PARALLEL_THRESHOLD)
+    for (long i = 0; i < n; i++)
+    {
+        data[i] = (data[i] - lo) * scale;
+    }
+}
+
+// Returns true if both buffers have the same size and all elements differ by at most tolerance.
+template< TensorLike SrcA, TensorLike SrcB >
+bool allClose(const SrcA& a, const SrcB& b, double tolerance)
+{
+    if (a.numElements() != b.numElements())
+    {
+        return false;
+    }
+
+    const auto* inA = a.data();
+    const auto* inB = b.data();
+    const auto n = static_cast< long >(a.numElements());
+    long mismatches = 0;
+
+#pragma omp parallel for simd reduction(+ : mismatches) if (static_cast< size_t >(n) >= PARALLEL_THRESHOLD)
+    for (long i = 0; i < n; i++)
+    {
+        mismatches += std::abs(static_cast< double >(inA[i]) - static_cast< double >(inB[i])) > tolerance;
+    }
+    return mismatches == 0;
+}
@@ -1,11 +1,19 @@
+#include "Intrinsics.hpp"
 #include "Eigen/Dense"
 #include "EigenDataSetLoader.hpp"
 #include "NeuralNetwork.hpp"
+#include "Schedulers.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 using Tensor = Eigen::MatrixXd;
@@ -85,6 +93,95 @@ std::map<std::string, std::string> read_network_configurations(const std::string
     return configs;
 }
 
+/**
+ * @brief Trains the network on the training set, reports the training time and evaluates it on the test set.
+ * Images are either a dense Tensor or a SparseTensor (CSR) batch source of the network's scalar type.
+ * With a target accuracy (percent, > 0) it measures the time to accuracy instead: the test set is evaluated after
+ * every epoch, outside of the timed training, and training stops once the accuracy reaches the target.
+ *
+ * @return The test accuracy in percent.
+ */
+template <typename Network, typename Images>
+double train_and_evaluate(Network &nn, const Images &train_images, const typename Network::Tensor &train_labels,
+                          const Images &test_images, const typename Network::Tensor &test_labels, int num_epochs,
+                          int batch_size, const std::string &rel_path_log_file, double target_accuracy = 0.0)
+{
+    std::cout << "Training images: " << train_images.rows() << ", Training labels: " << train_labels.rows() << std::endl;
+
+    std::cout << "Training the neural network..." << std::endl;
+
+    if (target_accuracy > 0.0)
+    {
+        std::chrono::duration<double> training_time(0.0);
+        double accuracy = 0.0;
+        int epoch = 0;
+        while (epoch < num_epochs && accuracy < target_accuracy)
+        {
+            auto start_time = std::chrono::high_resolution_clock::now();
+            nn.fit(train_images, train_labels, 1, batch_size, epoch);
+            training_time += std::chrono::high_resolution_clock::now() - start_time;
+            ++epoch;
+            accuracy = nn.evaluate(test_images, test_labels, batch_size, rel_path_log_file);
+            std::cout << "Epoch " << epoch << " test accuracy: " << accuracy << "% after " << training_time.count()
+                      << " seconds of training" << std::endl;
+        }
+        if (accuracy >= target_accuracy)
+        {
+            std::cout << "Time to " << target_accuracy << "% accuracy: " << training_time.count() << " seconds ("
+                      << epoch << " epochs)" << std::endl;
+        }
+        else
+        {
+            std::cout << "Target accuracy of " << target_accuracy << "% not reached in " << epoch << " epochs ("
+                      << training_time.count() << " seconds)" << std::endl;
+        }
+        return accuracy;
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    nn.fit(train_images, train_labels, num_epochs, batch_size);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time);
+
+    std::cout << "Training completed " << std::endl;
+    std::cout << "Training time: " << duration.count() << " seconds" << std::endl;
+
+    start_time = std::chrono::high_resolution_clock::now();
+    double accuracy = nn.evaluate(test_images, test_labels, batch_size, rel_path_log_file);
+    end_time = std::chrono::high_resolution_clock::now();
+    std::cout << "Evaluation time: " << std::chrono::duration<double, std::milli>(end_time - start_time).count()
+              << " ms" << std::endl;
+
+    return accuracy;
+}
+
+/**
+ * @brief Quantizes the trained network to int8, calibrated on the calibration_percentile percentile of the hidden
+ * activations over the first calibration_samples training images, and evaluates it on the raw test pixels. Reports
+ * its accuracy and evaluation time next to the ones of the network, and logs its predictions to
+ * <rel_path_log_file>.int8.
+ *
+ * @return The test accuracy of the int8 model in percent.
+ */
+template <typename Network, typename Images>
+double evaluate_quantized(const Network &nn, const Images &train_images, const PixelTensor &test_images,
+                          const typename Network::Tensor &test_labels, int calibration_samples,
+                          double calibration_percentile, int batch_size, const std::string &rel_path_log_file)
+{
+    const typename Network::Tensor calibration_images =
+        train_images.topRows(std::min<Eigen::Index>(calibration_samples, train_images.rows()));
+    int8::QuantizedNetwork quantized = nn.quantize(calibration_images, calibration_percentile);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    double accuracy = quantized.evaluate(test_images, test_labels, batch_size, rel_path_log_file + ".int8");
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::cout << "Int8 evaluation time (" << int8::kernel_name()
+              << "): " << std::chrono::duration<double, std::milli>(end_time - start_time).count() << " ms"
+              << std::endl;
+
+    return accuracy;
+}
+
 /**
  * @author Hamiz Ali
  * @since 24.01.2025
@@ -114,9 +211,154 @@ int main(int argc, char *argv[])
     }
     // configurations for the neural network
     int batch_size = std::stoi(configs["batch_size"]);
-    int hidden_size = std::stoi(configs["hidden_size"]);
+    // optional: hidden_sizes (e.g. 500, 300) stacks up to kMaxHiddenLayers fully connected hidden layers of these
+    // widths in place of the single one of hidden_size
+    std::vector<unsigned int> hidden_sizes;
+    if (configs["hidden_sizes"].empty())
+    {
+        hidden_sizes.push_back(std::stoi(configs["hidden_size"]));
+    }
+    else
+    {
+        std::stringstream widths(configs["hidden_sizes"]);
+        std::string width;
+        while (std::getline(widths, width, ','))
+        {
+            hidden_sizes.push_back(std::stoi(trim(width)));
+        }
+    }
+    if (hidden_sizes.empty() || hidden_sizes.size() > std::size_t(kMaxHiddenLayers) ||
+        std::find(hidden_sizes.begin(), hidden_sizes.end(), 0u) != hidden_sizes.end())
+    {
+        std::cerr << "Error: hidden_sizes needs 1 to " << kMaxHiddenLayers << " widths > 0" << std::endl;
+        return 1;
+    }
+    unsigned int hidden_size = hidden_sizes[0];
     double learning_rate = std::stod(configs["learning_rate"]);
     int num_epochs = std::stoi(configs["num_epochs"]);
+    // optional: keep the images in CSR format and let the first layer skip the zero pixels
+    bool sparse_input = configs["sparse_input"] == "true";
+    // optional: train with the fused softmax + cross entropy head, whose error tensor is p - y
+    bool fused_softmax_loss = configs["fused_softmax_loss"] == "true";
+    // optional: float32 trains and evaluates in single precision end to end, float64 (default) in double, bfloat16
+    // is float32 with bfloat16 products in the fully connected layers (mixed precision, fp32 master weights)
+    std::string scalar_type = configs["scalar_type"].empty() ? "float64" : configs["scalar_type"];
+    if (scalar_type != "float32" && scalar_type != "float64" && scalar_type != "bfloat16")
+    {
+        std::cerr << "Error: Unknown scalar_type " << scalar_type << " (expected float32, float64 or bfloat16)"
+                  << std::endl;
+        return 1;
+    }
+    bool mixed_precision = scalar_type == "bfloat16";
+    // optional: mlp (default) trains 784 -> hidden_size -> 10 fully connected layers, convnet a 5x5 convolution into
+    // hidden_size feature maps with 2x2 max pooling in place of the hidden layer
+    std::string architecture = configs["architecture"].empty() ? "mlp" : configs["architecture"];
+    if (architecture != "mlp" && architecture != "convnet")
+    {
+        std::cerr << "Error: Unknown architecture " << architecture << " (expected mlp or convnet)" << std::endl;
+        return 1;
+    }
+    bool convolutional = architecture == "convnet";
+    // optional: also evaluate a post-training int8 model, calibrated on the first calibration_samples (default 1000)
+    // training images, and report its accuracy against the trained network. A hidden unit maps the
+    // calibration_percentile (default 99.99, 100 is the maximum) percentile of its activations to 255.
+    bool quantized_inference = configs["quantized_inference"] == "true";
+    int calibration_samples =
+        configs["calibration_samples"].empty() ? 1000 : std::stoi(configs["calibration_samples"]);
+    double calibration_percentile = configs["calibration_percentile"].empty()
+                                        ? int8::kCalibrationPercentile
+                                        : std::stod(configs["calibration_percentile"]);
+    if (calibration_percentile <= 0.0 || calibration_percentile > 100.0)
+    {
+        std::cerr << "Error: calibration_percentile must be in (0, 100]" << std::endl;
+        return 1;
+    }
+    // optional: adam (default) or sgd, with momentum (default 0) and nesterov = true for Nesterov momentum
+    std::string optimizer_name = configs["optimizer"].empty() ? "adam" : configs["optimizer"];
+    if (optimizer_name != "adam" && optimizer_name != "sgd")
+    {
+        std::cerr << "Error: Unknown optimizer " << optimizer_name << " (expected adam or sgd)" << std::endl;
+        return 1;
+    }
+    double momentum = configs["momentum"].empty() ? 0.0 : std::stod(configs["momentum"]);
+    bool nesterov = configs["nesterov"] == "true";
+    if (optimizer_name != "sgd" && (momentum != 0.0 || nesterov))
+    {
+        std::cerr << "Error: momentum and nesterov only apply to the sgd optimizer" << std::endl;
+        return 1;
+    }
+    if (nesterov && momentum <= 0.0)
+    {
+        std::cerr << "Error: nesterov needs a momentum > 0" << std::endl;
+        return 1;
+    }
+    // optional: measure the time to this test accuracy (percent): evaluate after every epoch and stop training once
+    // it is reached, after at most num_epochs
+    double target_accuracy = configs["target_accuracy"].empty() ? 0.0 : std::stod(configs["target_accuracy"]);
+    // optional: learning rate schedule over the num_epochs epochs, set before every batch; learning_rate is the peak
+    // rate. constant (default), step (times lr_gamma, default 0.1, every lr_step_epochs, default 10), cosine (down to
+    // lr_min, default 0) or onecycle (up from learning_rate / 25 over the first lr_pct_start, default 0.3, of the
+    // steps, then down). All but onecycle ramp up linearly over the first warmup_epochs (default 0, may be fractional)
+    std::string schedule_name = configs["lr_schedule"].empty() ? "constant" : configs["lr_schedule"];
+    if (schedule_name != "constant" && schedule_name != "step" && schedule_name != "cosine" &&
+        schedule_name != "onecycle")
+    {
+        std::cerr << "Error: Unknown lr_schedule " << schedule_name << " (expected constant, step, cosine or onecycle)"
+                  << std::endl;
+        return 1;
+    }
+    double warmup_epochs = configs["warmup_epochs"].empty() ? 0.0 : std::stod(configs["warmup_epochs"]);
+    double lr_step_epochs = configs["lr_step_epochs"].empty() ? 10.0 : std::stod(configs["lr_step_epochs"]);
+    double lr_gamma = configs["lr_gamma"].empty() ? 0.1 : std::stod(configs["lr_gamma"]);
+    double lr_min = configs["lr_min"].empty() ? 0.0 : std::stod(configs["lr_min"]);
+    double lr_pct_start = configs["lr_pct_start"].empty() ? 0.3 : std::stod(configs["lr_pct_start"]);
+    if (warmup_epochs < 0.0 || lr_step_epochs <= 0.0 || lr_pct_start <= 0.0 || lr_pct_start >= 1.0)
+    {
+        std::cerr << "Error: warmup_epochs must be >= 0, lr_step_epochs > 0 and lr_pct_start in (0, 1)" << std::endl;
+        return 1;
+    }
+    if (schedule_name == "onecycle" && warmup_epochs > 0.0)
+    {
+        std::cerr << "Error: the onecycle schedule warms up over lr_pct_start instead of warmup_epochs" << std::endl;
+        return 1;
+    }
+    // The schedule in steps of the given number of batches per epoch; none keeps the constant learning rate
+    auto make_schedule = [&](long long steps_per_epoch) -> std::unique_ptr<LearningRateSchedule> {
+        const long long total_steps = num_epochs * steps_per_epoch;
+        const long long warmup_steps = std::llround(warmup_epochs * double(steps_per_epoch));
+        if (schedule_name == "step")
+        {
+            return std::make_unique<StepSchedule>(learning_rate, std::llround(lr_step_epochs * double(steps_per_epoch)),
+                                                  lr_gamma, warmup_steps);
+        }
+        if (schedule_name == "cosine")
+        {
+            return std::make_unique<CosineSchedule>(learning_rate, total_steps, lr_min, warmup_steps);
+        }
+        if (schedule_name == "onecycle")
+        {
+            return std::make_unique<OneCycleSchedule>(learning_rate, total_steps, lr_pct_start);
+        }
+        if (warmup_steps > 0)
+        {
+            return std::make_unique<ConstantSchedule>(learning_rate, warmup_steps);
+        }
+        return nullptr;
+    };
+    if (quantized_inference && convolutional)
+    {
+        std::cerr << "Error: quantized_inference is only available for the mlp architecture" << std::endl;
+        return 1;
+    }
+    if (hidden_sizes.size() > 1 && (convolutional || quantized_inference))
+    {
+        std::cerr << "Error: convnet and quantized_inference take a single hidden layer" << std::endl;
+        return 1;
+    }
+    if (mixed_precision)
+    {
+        std::cout << "Mixed precision kernel: " << bf16::kernel_name() << std::endl;
+    }
 
     // configurations for the dataset
     std::string rel_path_train_images = configs["rel_path_train_images"];
@@ -133,29 +375,100 @@ int main(int argc, char *argv[])
     EigenDataSetLoader read_test_images(rel_path_test_images);
     EigenDataSetLoader read_test_labels(rel_path_test_labels);
 
-    Tensor train_images = read_training_images.read_images();
-    Tensor train_labels = read_training_labels.read_labels();
-    Tensor test_images = read_test_images.read_images();
-    Tensor test_labels = read_test_labels.read_labels();
-
-    std::cout << "Training images: " << train_images.rows() << ", Training labels: " << train_labels.rows() << std::endl;
-
-    // Create and train the neural network
-    NeuralNetwork nn(784, hidden_size, 10, learning_rate);
+    // Create and train the neural network, with compile-time layer sizes if it has a single hidden layer of a
+    // registered width
+    double accuracy = 0.0;
+    double quantized_accuracy = 0.0;
+    auto run = [&]<typename Network>() {
+        using Scalar = typename Network::Tensor::Scalar;
+        const auto train_labels = read_training_labels.read_labels<Scalar>();
+        const auto test_labels = read_test_labels.read_labels<Scalar>();
 
-    std::cout << "Training the neural network..." << std::endl;
-
-    auto start_time = std::chrono::high_resolution_clock::now();
-    nn.fit(train_images, train_labels, num_epochs, batch_size);
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time);
-
-    std::cout << "Training completed " << std::endl;
-    std::cout << "Training time: " << duration.count() << " seconds" << std::endl;
-
-    double accuracy = nn.evaluate(test_images, test_labels, batch_size, rel_path_log_file);
+        std::unique_ptr<BasicOptimizer<Scalar>> optimizer;
+        if (optimizer_name == "sgd")
+        {
+            optimizer = std::make_unique<BasicSGD<Scalar>>(learning_rate, momentum, nesterov);
+        }
+        else
+        {
+            optimizer = std::make_unique<BasicADAM<Scalar>>(learning_rate, 0.9, 0.999, 1e-8);
+        }
+        Network nn(784, hidden_sizes, 10, *optimizer, batch_size, fused_softmax_loss, mixed_precision);
+        auto run_with = [&](const auto &train_images, const auto &test_images) {
+            // The layers are sized for 28x28 images (the convolution needs them square) and one label per image
+            if (train_images.cols() != 784 || test_images.cols() != 784)
+            {
+                std::cerr << "Error: The network takes 28x28 images, the datasets have " << train_images.cols()
+                          << " and " << test_images.cols() << " pixels per image" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            if (train_images.rows() != train_labels.rows() || test_images.rows() != test_labels.rows())
+            {
+                std::cerr << "Error: The datasets have " << train_images.rows() << " training images with "
+                          << train_labels.rows() << " labels and " << test_images.rows() << " test images with "
+                          << test_labels.rows() << " labels" << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            const std::unique_ptr<LearningRateSchedule> schedule =
+                make_schedule((train_images.rows() + batch_size - 1) / batch_size);
+            nn.set_schedule(schedule.get());
+            accuracy = train_and_evaluate(nn, train_images, train_labels, test_images, test_labels, num_epochs,
+                                          batch_size, rel_path_log_file, target_accuracy);
+            nn.set_schedule(nullptr);
+            if constexpr (requires { nn.quantize(std::declval<const typename Network::Tensor &>()); })
+            {
+                if (quantized_inference)
+                {
+                    EigenDataSetLoader read_test_pixels(rel_path_test_images);
+                    quantized_accuracy = evaluate_quantized(nn, train_images, read_test_pixels.read_images_raw(),
+                                                            test_labels, calibration_samples,
+                                                            calibration_percentile, batch_size, rel_path_log_file);
+                }
+            }
+        };
+        if (sparse_input)
+        {
+            run_with(read_training_images.read_images_sparse<Scalar>(), read_test_images.read_images_sparse<Scalar>());
+        }
+        else
+        {
+            run_with(read_training_images.read_images<Scalar>(), read_test_images.read_images<Scalar>());
+        }
+    };
+    if (convolutional)
+    {
+        // The convolutional network only has a dynamic shape, its GEMMs gain nothing from fixed sizes
+        if (scalar_type != "float64")
+        {
+            run.operator()<BasicNeuralNetwork<Eigen::Dynamic, Eigen::Dynamic, Eigen::Dynamic, float, true>>();
+        }
+        else
+        {
+            run.operator()<BasicNeuralNetwork<Eigen::Dynamic, Eigen::Dynamic, Eigen::Dynamic, double, true>>();
+        }
+        std::cout << "Network shape: 28x28 -> conv 5x5 x " << hidden_size << " -> max pool 2x2 -> 10 (" << scalar_type
+                  << ")" << std::endl;
+    }
+    else
+    {
+        bool fixed_shape = scalar_type != "float64" ? dispatch_network<float>(784, hidden_sizes, 10, run)
+                                                    : dispatch_network<double>(784, hidden_sizes, 10, run);
+        std::cout << "Network shape: 784 -> ";
+        for (unsigned int width : hidden_sizes)
+        {
+            std::cout << width << " -> ";
+        }
+        std::cout << "10 (" << (fixed_shape ? "fixed" : "dynamic")
+                  << ", " << scalar_type << ")" << std::endl;
+    }
 
     std::cout << "Testing completed: " << accuracy << "% >> Log File: " << rel_path_log_file << std::endl;
+    if (quantized_inference)
+    {
+        std::cout << "Int8 testing completed: " << quantized_accuracy << "% (" << std::showpos
+                  << quantized_accuracy - accuracy << std::noshowpos << " points vs " << scalar_type
+                  << ") >> Log File: " << rel_path_log_file << ".int8" << std::endl;
+    }
 
     return 0;
 }
@@ -1,4 +1,5 @@
 #include "tensor.hpp"
+#include "tensor_algorithms.hpp"
 
 #include <cstdint>
 #include <cstdlib>
@@ -94,14 +95,8 @@ uint32_t image_rd(std::string const& image_file_name, std::vector<Tensor<double>
         input.read( reinterpret_cast<char*>(raw_data.data()), image_size);
 
         Tensor<double> image( { ROWS, COLS } );
-        for (uint32_t row = 0; row < ROWS; row++) {
-            for (uint32_t col = 0; col < COLS; col++) {
-
-                int32_t const index = row * COLS + col;
-                image( { row, col } ) = raw_data[index] / 255.0;
-
-            }
-        }
+        TensorView<uint8_t const> const raw_view( raw_data.data(), { ROWS, COLS } );
+        transform( raw_view, image, []( uint8_t pixel ) { return pixel / 255.0; } );
 
         images.push_back( std::move( image ) );
 
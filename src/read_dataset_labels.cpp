@@ -83,16 +83,37 @@ uint32_t label_rd(std::string const &label_file_name, std::vector<Tensor<double>
     std::cout << 1 << std::endl;
     std::cout << 10 << std::endl;
 
+    // There are only ten distinct one-hot vectors, every label shares the buffer of one of them.
+    std::vector<Tensor<double>> one_hots;
+    one_hots.reserve( 10 );
+    for (size_t digit = 0; digit < 10; digit++) {
+
+        Tensor<double> one_hot( {10}, 0.0 );
+        one_hot({ digit }) = 1.0;
+
+        one_hots.push_back( std::move( one_hot ) );
+
+    }
+
     labels.reserve( ITEM_COUNT );
     for (uint32_t i = 0; i < ITEM_COUNT; i++) {
 
         uint8_t label;
         input.read( reinterpret_cast<char*>( &label ), 1 );
 
-        Tensor<double> one_hot( {10}, 0.0 );
-        one_hot({ label }) = 1.0;
+        if ( !input || label >= one_hots.size() ) {
+
+            std::cerr
+                << "Error: Failed to read labels."
+                << SPACE
+                << "File [" << label_file_name << "] has no digit label at index " << i << "!"
+                << std::endl;
+
+            exit( EXIT_FAILURE );
+
+        }
 
-        labels.push_back( std::move( one_hot ) );
+        labels.push_back( one_hots[label].share() );
 
     }
 